@@ -2,6 +2,7 @@
 #define API_AUDIO_CODECS_AUDIO_DECODER_SINK_H_
 
 #include <stdint.h>
+#include "api/array_view.h"
 #include "rtc_base/buffer.h"
 
 struct DecoderInitParam {
@@ -19,10 +20,18 @@ class AudioDecoderSink {
  public:
   virtual ~AudioDecoderSink() = default;
   virtual int AudioDecoderInit(struct DecoderInitParam& init_param) = 0;
-  virtual int DecodeAudio(uint8_t* encoded, uint32_t encoded_len,
+  // Decodes |encoded|, as it sits in the packet, into |decoded|. Writes at
+  // most decoded.size() samples across all channels. Returns the samples per
+  // channel.
+  virtual int DecodeAudio(rtc::ArrayView<const uint8_t> encoded,
                           uint32_t sample_rate, uint32_t channels,
-                          int16_t* decoded) = 0;
+                          rtc::ArrayView<int16_t> decoded) = 0;
   virtual int AudioDecoderUninit() = 0;
+  // Timing, for stats. Called after each decode, |ahead| if the decode
+  // worker ran it as the packet arrived rather than playout on demand.
+  virtual void OnAudioDecoded(int64_t decode_us, bool ahead) {}
+  // Called when playout wants a payload the worker has not decoded yet.
+  virtual void OnAudioDecodeLate() {}
 };
 
 #endif
\ No newline at end of file
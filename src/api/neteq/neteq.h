@@ -298,6 +298,12 @@ class NetEq {
   // The return value will be empty if no valid timestamp is available.
   virtual absl::optional<uint32_t> GetPlayoutTimestamp() const = 0;
 
+  // Maps an RTP timestamp of the stream, e.g. the one of a sender report, to
+  // the timestamps NetEq outputs audio with. They differ for AAC at an RTP
+  // clock other than 48 kHz; empty until NetEq has seen a packet to map from.
+  virtual absl::optional<uint32_t> MapRtpTimestamp(
+      uint32_t rtp_timestamp) const = 0;
+
   // Returns the sample rate in Hz of the audio produced in the last GetAudio
   // call. If GetAudio has not been called yet, the configured sample rate
   // (Config::sample_rate_hz) is returned.
@@ -30,6 +30,7 @@
 #include "rtc_base/logging.h"
 #include "rtc_base/strings/string_builder.h"
 #include "rtc_base/time_utils.h"
+#include "system_wrappers/include/ntp_time.h"
 
 namespace webrtc {
 
@@ -349,6 +350,18 @@ webrtc::AudioReceiveStream::Stats AudioReceiveStream::GetStats(
   stats.sender_reports_bytes_sent = call_stats.sender_reports_bytes_sent;
   stats.sender_reports_reports_count = call_stats.sender_reports_reports_count;
 
+  absl::optional<Syncable::Info> sync_info = channel_receive_->GetSyncInfo();
+  if (sync_info) {
+    // In the clock of the decoded audio, which is 48 kHz for AAC whatever
+    // its RTP clock; left unset until NetEq can map it.
+    stats.last_sender_report_rtp_timestamp =
+        channel_receive_->MapRtpTimestamp(sync_info->capture_time_source_clock);
+    stats.last_sender_report_ntp_ms =
+        NtpTime(sync_info->capture_time_ntp_secs,
+                sync_info->capture_time_ntp_frac)
+            .ToMs();
+  }
+
   return stats;
 }
 
@@ -20,6 +20,7 @@
 #include "modules/async_audio_processing/async_audio_processing.h"
 #include "modules/audio_processing/include/audio_frame_proxies.h"
 #include "rtc_base/checks.h"
+#include "rtc_base/event.h"
 
 namespace webrtc {
 
@@ -84,6 +85,109 @@ int Resample(const AudioFrame& frame,
 }
 }  // namespace
 
+// A few realtime threads pull the mixers of all AudioTransportImpl instances
+// in the process every 10ms, instead of a decoding thread per instance. Each
+// thread runs its own timer over its share of the instances, so a slow
+// Decode() only delays the streams on that thread.
+class AudioDecodingThreads {
+ public:
+  static AudioDecodingThreads* Get() {
+    // Never destroyed, the threads run for the life of the process.
+    static AudioDecodingThreads* const instance = new AudioDecodingThreads();
+    return instance;
+  }
+
+  // Onto the thread with the fewest instances, started on first use. Picks
+  // from the counts kept here, a shard's own lock is held through its rounds.
+  void Add(AudioTransportImpl* transport) {
+    MutexLock lock(&mutex_);
+    Shard* least = &shards_[0];
+    for (Shard& shard : shards_) {
+      if (shard.count < least->count) {
+        least = &shard;
+      }
+    }
+    least->Add(transport);
+    ++least->count;
+  }
+
+  // Returns once `transport` is out of the current round.
+  void Remove(AudioTransportImpl* transport) {
+    MutexLock lock(&mutex_);
+    for (Shard& shard : shards_) {
+      if (shard.count > 0 && shard.Remove(transport)) {
+        --shard.count;
+        break;
+      }
+    }
+  }
+
+ private:
+  static constexpr size_t kThreadCount = 4;
+
+  class Shard {
+   public:
+    void Add(AudioTransportImpl* transport) {
+      {
+        MutexLock lock(&mutex_);
+        transports_.push_back(transport);
+      }
+      if (!started_) {
+        started_ = true;
+        timer_ = rtc::Timer::CreateTimer(10000);
+        rtc::PlatformThread::SpawnDetached(
+            [this]() { Run(); }, "DecodingThread",
+            rtc::ThreadAttributes().SetPriority(rtc::ThreadPriority::kRealtime));
+      }
+      wake_.Set();
+    }
+
+    // Returns false if `transport` is not on this shard.
+    bool Remove(AudioTransportImpl* transport) {
+      MutexLock lock(&mutex_);
+      auto it = std::find(transports_.begin(), transports_.end(), transport);
+      if (it == transports_.end()) {
+        return false;
+      }
+      transports_.erase(it);
+      return true;
+    }
+
+    // Instances on the shard, guarded by AudioDecodingThreads::mutex_.
+    size_t count = 0;
+
+   private:
+    void Run() {
+      timer_->start();
+      while (true) {
+        bool idle;
+        {
+          MutexLock lock(&mutex_);
+          for (AudioTransportImpl* transport : transports_) {
+            transport->Decode();
+          }
+          idle = transports_.empty();
+        }
+        if (idle) {
+          wake_.Wait(rtc::Event::kForever);
+          timer_->start();
+        } else {
+          timer_->WaitUntilNext();
+        }
+      }
+    }
+
+    Mutex mutex_;
+    std::vector<AudioTransportImpl*> transports_ RTC_GUARDED_BY(mutex_);
+    rtc::Event wake_;
+    bool started_ = false;   // guarded by AudioDecodingThreads::mutex_
+    std::unique_ptr<rtc::Timer> timer_;
+  };
+
+  Mutex mutex_;
+  Shard shards_[kThreadCount] RTC_GUARDED_BY(mutex_);
+};
+
 AudioTransportImpl::AudioTransportImpl(
     AudioMixer* mixer,
     AudioProcessing* audio_processing,
@@ -96,23 +200,13 @@ AudioTransportImpl::AudioTransportImpl(
                       this->SendProcessedData(std::move(frame));
                     })
               : nullptr),
-      timer_(rtc::Timer::CreateTimer(10000)),
       mixer_(mixer) {
   RTC_DCHECK(mixer);
-
-  playing_ = true;
-  timer_->start();
-  decode_thread_ = rtc::PlatformThread::SpawnJoinable(
-    [this]() {
-      while (Decode());
-    },
-    "DecodingThread",
-    rtc::ThreadAttributes().SetPriority(rtc::ThreadPriority::kRealtime));
+  AudioDecodingThreads::Get()->Add(this);
 }
 
 AudioTransportImpl::~AudioTransportImpl() {
-  playing_ = false;
-  decode_thread_.Finalize();
+  AudioDecodingThreads::Get()->Remove(this);
 }
 
 // Not used in Chromium. Process captured audio and distribute to all sending
@@ -290,10 +384,8 @@ bool AudioTransportImpl::typing_noise_detected() const {
   return typing_noise_detected_;
 }
 
-bool AudioTransportImpl::Decode() {
-  timer_->WaitUntilNext();
+void AudioTransportImpl::Decode() {
   mixer_->Mix(1, &mixed_frame_);
-  return playing_;
 }
 
 }  // namespace webrtc
@@ -91,11 +91,10 @@ class AudioTransportImpl : public AudioTransport {
   mutable Mutex capture_lock_;
   std::vector<AudioSender*> audio_senders_ RTC_GUARDED_BY(capture_lock_);
 
-  bool Decode();
+  // Pulls 10ms from the mixer. Called by AudioDecodingThreads.
+  friend class AudioDecodingThreads;
+  void Decode();
 
-  bool playing_ {false};
-  rtc::PlatformThread decode_thread_;
-  std::unique_ptr<rtc::Timer> timer_ {nullptr};
   int send_sample_rate_hz_ RTC_GUARDED_BY(capture_lock_) = 8000;
   size_t send_num_channels_ RTC_GUARDED_BY(capture_lock_) = 1;
   bool typing_noise_detected_ RTC_GUARDED_BY(capture_lock_) = false;
@@ -154,6 +154,8 @@ class ChannelReceive : public ChannelReceiveInterface,
 
   // Produces the transport-related timestamps; current_delay_ms is left unset.
   absl::optional<Syncable::Info> GetSyncInfo() const override;
+  absl::optional<uint32_t> MapRtpTimestamp(
+      uint32_t rtp_timestamp) const override;
 
   void RegisterReceiverCongestionControlObjects(
       PacketRouter* packet_router) override;
@@ -1023,6 +1025,11 @@ int ChannelReceive::GetBaseMinimumPlayoutDelayMs() const {
   return acm_receiver_.GetBaseMinimumDelayMs();
 }
 
+absl::optional<uint32_t> ChannelReceive::MapRtpTimestamp(
+    uint32_t rtp_timestamp) const {
+  return acm_receiver_.MapRtpTimestamp(rtp_timestamp);
+}
+
 absl::optional<Syncable::Info> ChannelReceive::GetSyncInfo() const {
   // TODO(bugs.webrtc.org/11993): This should run on the network thread.
   // We get here via RtpStreamsSynchronizer. Once that's done, many of
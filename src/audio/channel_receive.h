@@ -134,6 +134,10 @@ class ChannelReceiveInterface : public RtpPacketSinkInterface {
 
   // Produces the transport-related timestamps; current_delay_ms is left unset.
   virtual absl::optional<Syncable::Info> GetSyncInfo() const = 0;
+  // Maps an RTP timestamp of the stream to the timestamps of the decoded
+  // audio, which NetEq rescales for AAC.
+  virtual absl::optional<uint32_t> MapRtpTimestamp(
+      uint32_t rtp_timestamp) const = 0;
 
   virtual void RegisterReceiverCongestionControlObjects(
       PacketRouter* packet_router) = 0;
@@ -97,6 +97,10 @@ class AudioReceiveStream : public MediaReceiveStream {
     uint32_t sender_reports_packets_sent = 0;
     uint64_t sender_reports_bytes_sent = 0;
     uint64_t sender_reports_reports_count = 0;
+    // RTP timestamp and NTP time of the last RTCP sender report, the mapping
+    // the stream synchronizer uses.
+    absl::optional<uint32_t> last_sender_report_rtp_timestamp;
+    absl::optional<int64_t> last_sender_report_ntp_ms;
   };
 
   struct Config {
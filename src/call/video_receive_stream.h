@@ -139,6 +139,14 @@ class VideoReceiveStream : public MediaReceiveStream {
     std::string c_name;
     RtpReceiveStats rtp_stats;
     RtcpPacketTypeCounter rtcp_packet_type_counts;
+    // Packets received on the RTX ssrc, i.e. retransmissions.
+    uint32_t rtx_packets_received = 0;
+    // Frames held by the FrameBuffer, complete or not.
+    int frame_buffer_frames = 0;
+    // RTP timestamp and NTP time of the last RTCP sender report, the mapping
+    // the stream synchronizer uses.
+    absl::optional<uint32_t> last_sender_report_rtp_timestamp;
+    absl::optional<int64_t> last_sender_report_ntp_ms;
 
     // Timing frame info: all important timestamps for a full lifetime of a
     // single 'timing frame'.
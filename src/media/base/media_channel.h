@@ -442,6 +442,9 @@ struct MediaReceiverInfo {
   absl::optional<int64_t> last_packet_received_timestamp_ms;
   // https://w3c.github.io/webrtc-stats/#dom-rtcinboundrtpstreamstats-estimatedplayouttimestamp
   absl::optional<int64_t> estimated_playout_ntp_timestamp_ms;
+  // RTP timestamp and NTP time of the last RTCP sender report.
+  absl::optional<uint32_t> last_sender_report_rtp_timestamp;
+  absl::optional<int64_t> last_sender_report_ntp_ms;
   std::string codec_name;
   absl::optional<int> codec_payload_type;
   std::vector<SsrcReceiverInfo> local_stats;
@@ -634,6 +637,10 @@ struct VideoReceiverInfo : public MediaReceiverInfo {
   int target_delay_ms = 0;
   // Current overall delay, possibly ramping towards target_delay_ms.
   int current_delay_ms = 0;
+  // Retransmissions received on the RTX ssrc.
+  uint32_t rtx_packets_rcvd = 0;
+  // Frames held by the jitter buffer, complete or not.
+  int buffered_frames = 0;
 
   // Estimated capture start time in NTP time in ms.
   int64_t capture_start_ntp_time_ms = -1;
@@ -3178,6 +3178,8 @@ WebRtcVideoChannel::WebRtcVideoReceiveStream::GetVideoReceiverInfo(
   info.decode_ms = stats.decode_ms;
   info.max_decode_ms = stats.max_decode_ms;
   info.current_delay_ms = stats.current_delay_ms;
+  info.rtx_packets_rcvd = stats.rtx_packets_received;
+  info.buffered_frames = stats.frame_buffer_frames;
   info.target_delay_ms = stats.target_delay_ms;
   info.jitter_buffer_ms = stats.jitter_buffer_ms;
   info.jitter_buffer_delay_seconds = stats.jitter_buffer_delay_seconds;
@@ -3196,6 +3198,9 @@ WebRtcVideoChannel::WebRtcVideoReceiveStream::GetVideoReceiverInfo(
       stats.rtp_stats.last_packet_received_timestamp_ms;
   info.estimated_playout_ntp_timestamp_ms =
       stats.estimated_playout_ntp_timestamp_ms;
+  info.last_sender_report_rtp_timestamp =
+      stats.last_sender_report_rtp_timestamp;
+  info.last_sender_report_ntp_ms = stats.last_sender_report_ntp_ms;
   info.first_frame_received_to_decoded_ms =
       stats.first_frame_received_to_decoded_ms;
   info.total_inter_frame_delay = stats.total_inter_frame_delay;
@@ -2526,6 +2526,9 @@ bool WebRtcVoiceMediaChannel::GetStats(VoiceMediaInfo* info,
     rinfo.sender_reports_packets_sent = stats.sender_reports_packets_sent;
     rinfo.sender_reports_bytes_sent = stats.sender_reports_bytes_sent;
     rinfo.sender_reports_reports_count = stats.sender_reports_reports_count;
+    rinfo.last_sender_report_rtp_timestamp =
+        stats.last_sender_report_rtp_timestamp;
+    rinfo.last_sender_report_ntp_ms = stats.last_sender_report_ntp_ms;
 
     if (recv_nack_enabled_) {
       rinfo.nacks_sent = stats.nacks_sent;
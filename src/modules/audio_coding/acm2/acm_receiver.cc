@@ -228,6 +228,11 @@ absl::optional<uint32_t> AcmReceiver::GetPlayoutTimestamp() {
   return neteq_->GetPlayoutTimestamp();
 }
 
+absl::optional<uint32_t> AcmReceiver::MapRtpTimestamp(
+    uint32_t rtp_timestamp) const {
+  return neteq_->MapRtpTimestamp(rtp_timestamp);
+}
+
 int AcmReceiver::FilteredCurrentDelayMs() const {
   return neteq_->FilteredCurrentDelayMs();
 }
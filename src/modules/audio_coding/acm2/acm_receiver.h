@@ -155,6 +155,10 @@ class AcmReceiver {
   // The return value will be empty if no valid timestamp is available.
   absl::optional<uint32_t> GetPlayoutTimestamp();
 
+  // Maps an RTP timestamp of the stream to the timestamps of the audio
+  // delivered by GetAudio(). See NetEq::MapRtpTimestamp().
+  absl::optional<uint32_t> MapRtpTimestamp(uint32_t rtp_timestamp) const;
+
   // Returns the current total delay from NetEq (packet buffer and sync buffer)
   // in ms, with smoothing applied to even out short-time fluctuations due to
   // jitter. The packet buffer part of the delay is not updated during DTX/CNG
@@ -1,41 +1,239 @@
 #include "audio_decoder_aac.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <vector>
+
 #include "api/audio/audio_frame.h"
+#include "modules/include/module_common_types_public.h"
+#include "rtc_base/bit_buffer.h"
 #include "rtc_base/logging.h"
+#include "rtc_base/task_utils/to_queued_task.h"
+#include "rtc_base/time_utils.h"
+
+namespace {
+
+// NetEqImpl scales AAC timestamps to 48 kHz, durations are given in the
+// same clock.
+constexpr int kAacTimestampClockHz = 48000;
+constexpr size_t kAdtsHeaderSize = 7;
+constexpr uint32_t kLoasSyncWord = 0x2b7;
+constexpr uint32_t kSbrSyncExtension = 0x2b7;
+constexpr uint32_t kPsSyncExtension = 0x548;
+const int kAacSampleRates[] = {96000, 88200, 64000, 48000, 44100, 32000,
+                               24000, 22050, 16000, 12000, 11025, 8000, 7350};
+constexpr uint32_t kAacSampleRateCount = sizeof(kAacSampleRates) / sizeof(kAacSampleRates[0]);
+// Room for one decoded payload, per channel: NetEq's largest frame, 120 ms
+// at 48 kHz.
+constexpr size_t kMaxDecodedSamples = 5760;
+// NetEqImpl rounds each scaled timestamp on its own, consecutive packets
+// step by their duration give or take a tick.
+constexpr int32_t kTimestampSlack = 2;
+// Decode threads shared by all AAC decoders.
+constexpr size_t kAacDecodeThreads = 2;
+
+bool ReadObjectType(rtc::BitBuffer& bb, uint32_t& object_type) {
+  if (!bb.ReadBits(5, object_type)) {
+    return false;
+  }
+  if (object_type == 31) {
+    uint32_t extension = 0;
+    if (!bb.ReadBits(6, extension)) {
+      return false;
+    }
+    object_type = 32 + extension;
+  }
+  return true;
+}
+
+bool ReadSampleRate(rtc::BitBuffer& bb, int& sample_rate_hz) {
+  uint32_t index = 0;
+  if (!bb.ReadBits(4, index)) {
+    return false;
+  }
+  if (index == 0xf) {
+    uint32_t rate = 0;
+    if (!bb.ReadBits(24, rate) || rate == 0) {
+      return false;
+    }
+    sample_rate_hz = static_cast<int>(rate);
+    return true;
+  }
+  if (index >= kAacSampleRateCount) {
+    return false;
+  }
+  sample_rate_hz = kAacSampleRates[index];
+  return true;
+}
+
+// AudioSpecificConfig (ISO/IEC 14496-3 1.6.2.1) of a general audio object
+// type. Leaves |bb| after it, as StreamMuxConfig with audioMuxVersion 0 needs.
+bool ReadAudioSpecificConfig(rtc::BitBuffer& bb, int& sample_rate_hz, int& frame_samples) {
+  uint32_t object_type = 0;
+  uint32_t channel_config = 0;
+  if (!ReadObjectType(bb, object_type) || !ReadSampleRate(bb, sample_rate_hz) ||
+      !bb.ReadBits(4, channel_config)) {
+    return false;
+  }
+  bool explicit_sbr = object_type == 5 || object_type == 29;
+  if (explicit_sbr) {
+    // The rate read above is the core rate, the SBR output rate follows.
+    int sbr_sample_rate_hz = 0;
+    if (!ReadSampleRate(bb, sbr_sample_rate_hz) || !ReadObjectType(bb, object_type)) {
+      return false;
+    }
+  }
+
+  // GASpecificConfig.
+  uint32_t short_frame = 0;
+  switch (object_type) {
+    case 1: case 2: case 3: case 4: case 6: case 7:
+    case 17: case 19: case 20: case 21: case 22:
+      if (!bb.ReadBits(1, short_frame)) {
+        return false;
+      }
+      frame_samples = short_frame ? 960 : 1024;
+      break;
+    case 23:   // ER AAC LD
+      if (!bb.ReadBits(1, short_frame)) {
+        return false;
+      }
+      frame_samples = short_frame ? 480 : 512;
+      break;
+    default:
+      return false;
+  }
+  uint32_t depends_on_core_coder = 0;
+  uint32_t extension_flag = 0;
+  if (channel_config == 0 ||   // program_config_element() is not parsed
+      !bb.ReadBits(1, depends_on_core_coder) ||
+      (depends_on_core_coder && !bb.ConsumeBits(14)) ||
+      !bb.ReadBits(1, extension_flag)) {
+    return false;
+  }
+  if ((object_type == 6 || object_type == 20) && !bb.ConsumeBits(3)) {
+    return false;
+  }
+  if (extension_flag) {
+    if (object_type == 22 && !bb.ConsumeBits(16)) {
+      return false;
+    }
+    if ((object_type == 17 || object_type == 19 || object_type == 20 || object_type == 23) &&
+        !bb.ConsumeBits(3)) {
+      return false;
+    }
+    if (!bb.ConsumeBits(1)) {
+      return false;
+    }
+  }
+  uint32_t ep_config = 0;
+  if (object_type >= 17 && (!bb.ReadBits(2, ep_config) || ep_config >= 2)) {
+    return false;
+  }
+
+  // Backward compatible SBR/PS signaling, rates stay the core ones.
+  uint32_t sync = 0;
+  if (!explicit_sbr && bb.PeekBits(11, sync) && sync == kSbrSyncExtension) {
+    uint32_t extension_type = 0;
+    uint32_t sbr_present = 0;
+    int sbr_sample_rate_hz = 0;
+    if (!bb.ConsumeBits(11) || !ReadObjectType(bb, extension_type)) {
+      return false;
+    }
+    if (extension_type == 5) {
+      if (!bb.ReadBits(1, sbr_present) ||
+          (sbr_present && !ReadSampleRate(bb, sbr_sample_rate_hz))) {
+        return false;
+      }
+      if (sbr_present && bb.PeekBits(11, sync) && sync == kPsSyncExtension && !bb.ConsumeBits(12)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// StreamMuxConfig (ISO/IEC 14496-3 1.7.3.1), audioMuxVersion 0 with one
+// program and layer carrying AAC.
+bool ReadStreamMuxConfig(rtc::BitBuffer& bb, int& sample_rate_hz, int& frame_samples, int& frames) {
+  uint32_t audio_mux_version = 0;
+  uint32_t num_sub_frames = 0;
+  uint32_t num_program = 0;
+  uint32_t num_layer = 0;
+  uint32_t frame_length_type = 0;
+  if (!bb.ReadBits(1, audio_mux_version) || audio_mux_version != 0 ||
+      !bb.ConsumeBits(1) ||   // allStreamsSameTimeFraming
+      !bb.ReadBits(6, num_sub_frames) ||
+      !bb.ReadBits(4, num_program) || num_program != 0 ||
+      !bb.ReadBits(3, num_layer) || num_layer != 0 ||
+      !ReadAudioSpecificConfig(bb, sample_rate_hz, frame_samples)) {
+    return false;
+  }
+  if (!bb.ReadBits(3, frame_length_type)) {
+    frame_length_type = 0;   // config cut short after the AudioSpecificConfig
+  }
+  // Other frame length types carry CELP or HVXC, not AAC.
+  frames = static_cast<int>(num_sub_frames) + 1;
+  return frame_length_type == 0;
+}
+
+} // namespace
 
 namespace webrtc {
 
+// A payload as NetEq got it, shared by its AacFrame and the decode worker.
+struct AacDecodeJob {
+  AacDecodeJob(rtc::Buffer&& payload, uint32_t timestamp, int duration, uint32_t generation)
+    : payload(std::move(payload)),
+      timestamp(timestamp),
+      duration(duration),
+      generation(generation) {}
+
+  const rtc::Buffer payload;
+  const uint32_t timestamp;
+  const int duration;       // PacketDuration() on arrival
+  const uint32_t generation;
+  // Set once |pcm| holds the decode, read by playout without the lock.
+  std::atomic<bool> staged{false};
+  // Set when NetEq drops the frame, the worker skips it then.
+  std::atomic<bool> released{false};
+  // Guarded by AudioDecoderAacImpl::decode_mutex_.
+  bool taken = false;     // decoded, by the worker or by playout
+  int samples = 0;        // as DecodeFrame() returned
+  AudioDecoder::SpeechType speech_type = AudioDecoder::kSpeech;
+  rtc::BufferT<int16_t> pcm;
+};
+
 class AacFrame : public AudioDecoder::EncodedAudioFrame {
  public:
   AacFrame(AudioDecoderAacImpl* decoder,
-           rtc::Buffer&& payload,
+           std::shared_ptr<AacDecodeJob> job,
            bool is_primary_payload)
     : decoder_(decoder),
-      payload_(std::move(payload)),
+      job_(std::move(job)),
       is_primary_payload_(is_primary_payload) {}
+  ~AacFrame() override { job_->released.store(true, std::memory_order_relaxed); }
 
   size_t Duration() const override {
+    const rtc::Buffer& payload = job_->payload;
     int ret;
     if (is_primary_payload_) {
-      ret = decoder_->PacketDuration(payload_.data(), payload_.size());
+      ret = decoder_->PacketDuration(payload.data(), payload.size());
     } else {
-      ret = decoder_->PacketDurationRedundant(payload_.data(), payload_.size());
+      ret = decoder_->PacketDurationRedundant(payload.data(), payload.size());
     }
     return (ret < 0) ? 0 : static_cast<size_t>(ret);
   }
 
-  bool IsDtxPacket() const override { return payload_.size() <= 2; }
+  bool IsDtxPacket() const override { return job_->payload.size() <= 2; }
 
   absl::optional<DecodeResult> Decode(
     rtc::ArrayView<int16_t> decoded) const override {
     AudioDecoder::SpeechType speech_type = AudioDecoder::kSpeech;
-    int ret;
-    if (is_primary_payload_) {
-      ret = decoder_->Decode(payload_.data(), payload_.size(), decoder_->SampleRateHz(), 
-                             decoded.size()*sizeof(int16_t), decoded.data(), &speech_type);
-    } else {
-      ret = decoder_->DecodeRedundant(payload_.data(), payload_.size(), decoder_->SampleRateHz(), 
-                                      decoded.size()*sizeof(int16_t), decoded.data(), &speech_type);
-    }
+    // Primary and redundant payloads decode the same, bounded by the room
+    // left in |decoded|.
+    int ret = decoder_->DecodeStaged(*job_, decoded, &speech_type);
 
     if (ret < 0) {
       return absl::nullopt;
@@ -46,10 +244,51 @@ class AacFrame : public AudioDecoder::EncodedAudioFrame {
 
  private:
   AudioDecoderAacImpl* const decoder_;
-  const rtc::Buffer payload_;
+  const std::shared_ptr<AacDecodeJob> job_;
   const bool is_primary_payload_;
 };
 
+struct AacDecodeLink {
+  Mutex mutex;
+  AudioDecoderAacImpl* decoder RTC_GUARDED_BY(mutex) = nullptr;
+};
+
+// Started on first use and kept for the process. Each decoder posts to one
+// thread only, so its jobs run in the order posted.
+class AacDecodeThreads {
+ public:
+  static AacDecodeThreads* Get() {
+    static AacDecodeThreads* const threads = new AacDecodeThreads();
+    return threads;
+  }
+
+  // Round robin, null if no thread started.
+  rtc::Thread* Next() {
+    MutexLock lock(&mutex_);
+    if (threads_.empty()) {
+      return nullptr;
+    }
+    return threads_[next_++ % threads_.size()].get();
+  }
+
+ private:
+  AacDecodeThreads() {
+    for (size_t i = 0; i < kAacDecodeThreads; ++i) {
+      std::unique_ptr<rtc::Thread> thread = rtc::Thread::Create();
+      thread->SetName("AacDecodeThread", nullptr);
+      if (!thread->Start()) {
+        RTC_LOG(LS_ERROR) << "[AAC]AacDecodeThreads() decode thread " << i << " not started.";
+        continue;
+      }
+      threads_.push_back(std::move(thread));
+    }
+  }
+
+  Mutex mutex_;
+  std::vector<std::unique_ptr<rtc::Thread>> threads_;
+  size_t next_ RTC_GUARDED_BY(mutex_) = 0;
+};
+
 AudioDecoderAacImpl::AudioDecoderAacImpl(AudioDecoderSink* sink,
                                          size_t num_channels,
                                          int dec_hz,
@@ -59,7 +298,14 @@ AudioDecoderAacImpl::AudioDecoderAacImpl(AudioDecoderSink* sink,
                                          bool ps_enabled,
                                          uint8_t *extra_data,
                                          int extra_data_len)
-    :  sink_(std::move(sink)) {
+    :  sink_(std::move(sink)),
+       last_packet_duration_(0),
+       decode_thread_(nullptr),
+       decode_link_(std::make_shared<AacDecodeLink>()),
+       generation_(0),
+       has_last_decoded_(false),
+       last_decoded_timestamp_(0),
+       last_decoded_duration_(0) {
   RTC_LOG(LS_INFO) << "[AAC]AudioDecoderAacImpl::AudioDecoderAacImpl() ch:" << num_channels
                    << ", dec_hz:" << dec_hz
                    << ", clockrate_hz:" << clockrate_hz << ", use_latm:" << use_latm
@@ -79,13 +325,32 @@ AudioDecoderAacImpl::AudioDecoderAacImpl(AudioDecoderSink* sink,
     init_param_.extra_data.SetData(extra_data, extra_data_len);
   }
 
+  if (!use_latm && extra_data && extra_data_len) {
+    // LATM without in band config: the StreamMuxConfig from the SDP.
+    rtc::BitBuffer bb(extra_data, extra_data_len);
+    if (!ReadStreamMuxConfig(bb, config_framing_.sample_rate_hz, config_framing_.frame_samples,
+                             config_framing_.frames)) {
+      RTC_LOG(LS_WARNING) << "[AAC]AudioDecoderAacImpl() unknown framing in config, no packet durations.";
+      config_framing_.sample_rate_hz = 0;
+    }
+  }
+
   if (sink_) {
     sink_->AudioDecoderInit(init_param_);
+    decode_thread_ = AacDecodeThreads::Get()->Next();
+    MutexLock lock(&decode_link_->mutex);
+    decode_link_->decoder = this;
   }
 }
 
 AudioDecoderAacImpl::~AudioDecoderAacImpl() {
   RTC_LOG(LS_INFO) << "AudioDecoderAacImpl::~AudioDecoderAacImpl()";
+  {
+    // Waits for a decode running on the shared thread, the ones still
+    // queued find no decoder.
+    MutexLock lock(&decode_link_->mutex);
+    decode_link_->decoder = nullptr;
+  }
   if (sink_) {
     sink_->AudioDecoderUninit();
   }
@@ -94,13 +359,70 @@ AudioDecoderAacImpl::~AudioDecoderAacImpl() {
 std::vector<AudioDecoder::ParseResult> AudioDecoderAacImpl::ParsePayload(rtc::Buffer&& payload,
                                                                          uint32_t timestamp) {
   std::vector<ParseResult> results;
-  std::unique_ptr<EncodedAudioFrame> frame(new AacFrame(this, std::move(payload), true));
+  int duration = PacketDuration(payload.data(), payload.size());
+  auto job = std::make_shared<AacDecodeJob>(std::move(payload), timestamp, duration, generation_.load());
+  if (decode_thread_) {
+    PostDecodeAhead(job);
+  }
+  std::unique_ptr<EncodedAudioFrame> frame(new AacFrame(this, std::move(job), true));
   results.emplace_back(timestamp, 0, std::move(frame));
   return results;
 }
 
 int AudioDecoderAacImpl::PacketDuration(const uint8_t* encoded, size_t encoded_len) const {
-  return 0;//static_cast<int>(encoded_len / Channels() / 2);
+  Framing framing;
+  if (ParseFraming(encoded, encoded_len, &framing) && framing.sample_rate_hz > 0) {
+    // Same span whether SBR doubles the output samples or not.
+    last_packet_duration_ = static_cast<int>(static_cast<int64_t>(framing.frames) * framing.frame_samples *
+                                             kAacTimestampClockHz / framing.sample_rate_hz);
+  }
+  return last_packet_duration_;
+}
+
+bool AudioDecoderAacImpl::ParseFraming(const uint8_t* encoded, size_t encoded_len, Framing* framing) const {
+  // ADTS streams have neither in band nor SDP config. Checked first, as a
+  // LATM PayloadLengthInfo may start like an ADTS header.
+  bool adts = !init_param_.use_latm && init_param_.extra_data.size() == 0;
+  if (adts && encoded_len >= kAdtsHeaderSize && encoded[0] == 0xff && (encoded[1] & 0xf0) == 0xf0) {
+    // One or more ADTS frames, each of 1 to 4 raw data blocks of 1024.
+    framing->frames = 0;
+    size_t offset = 0;
+    while (offset + kAdtsHeaderSize <= encoded_len && encoded[offset] == 0xff &&
+           (encoded[offset + 1] & 0xf0) == 0xf0) {
+      const uint8_t* header = encoded + offset;
+      uint32_t sr_idx = (header[2] & 0x3c) >> 2;
+      size_t frame_length = ((header[3] & 0x03) << 11) | (header[4] << 3) | ((header[5] & 0xe0) >> 5);
+      if (sr_idx >= kAacSampleRateCount || frame_length < kAdtsHeaderSize) {
+        break;
+      }
+      framing->sample_rate_hz = kAacSampleRates[sr_idx];
+      framing->frames += (header[6] & 0x03) + 1;
+      offset += frame_length;
+    }
+    return framing->frames > 0;
+  }
+
+  rtc::BitBuffer bb(encoded, encoded_len);
+  uint32_t sync = 0;
+  if (init_param_.use_latm && bb.PeekBits(11, sync) && sync == kLoasSyncWord) {
+    uint32_t use_same_stream_mux = 0;
+    if (!bb.ConsumeBits(24) ||   // sync word and audioMuxLengthBytes
+        !bb.ReadBits(1, use_same_stream_mux)) {
+      return false;
+    }
+    if (!use_same_stream_mux) {
+      Framing parsed;
+      if (!ReadStreamMuxConfig(bb, parsed.sample_rate_hz, parsed.frame_samples, parsed.frames)) {
+        return false;
+      }
+      loas_framing_ = parsed;
+    }
+    *framing = loas_framing_;
+    return true;
+  }
+
+  *framing = config_framing_;
+  return true;
 }
 
 int AudioDecoderAacImpl::PacketDurationRedundant(const uint8_t* encoded,
@@ -110,6 +432,10 @@ int AudioDecoderAacImpl::PacketDurationRedundant(const uint8_t* encoded,
 
 void AudioDecoderAacImpl::Reset() {
   RTC_LOG(LS_INFO) << "AudioDecoderAacImpl::Reset()";
+  MutexLock lock(&decode_mutex_);
+  ++generation_;
+  has_last_decoded_ = false;
+  pending_.clear();
   if (sink_) {
     sink_->AudioDecoderInit(init_param_);
   }
@@ -123,25 +449,153 @@ size_t AudioDecoderAacImpl::Channels() const {
   return init_param_.num_channels;
 }
 
-int AudioDecoderAacImpl::DecodeInternal(const uint8_t* encoded,
-                                        size_t encoded_len,
-                                        int sample_rate_hz,
-                                        int16_t* decoded,
-                                        SpeechType* speech_type) {
-  // RTC_LOG(LS_INFO) << "AudioDecoderAacImpl::DecodeInternal encoded_len:" << encoded_len << " sample_rate_hz:" << sample_rate_hz;
+int AudioDecoderAacImpl::DecodeFrame(rtc::ArrayView<const uint8_t> encoded,
+                                     rtc::ArrayView<int16_t> decoded,
+                                     SpeechType* speech_type) {
   int ret = 0;
   int16_t temp_type = 1;  // Default is speech.
-  uint8_t audio_encoded[2048] = {0};
-  memcpy(audio_encoded, encoded, encoded_len);
   if (sink_) {
-    ret = sink_->DecodeAudio(audio_encoded, encoded_len, sample_rate_hz, init_param_.num_channels, decoded);
+    ret = sink_->DecodeAudio(encoded, SampleRateHz(), init_param_.num_channels, decoded);
   }
-   if (ret > 0)
-     ret *= static_cast<int>(init_param_.num_channels);  // Return total number of samples.
+  if (ret > 0)
+    ret *= static_cast<int>(init_param_.num_channels);  // Return total number of samples.
   *speech_type = ConvertSpeechType(temp_type);
-  // RTC_LOG(LS_INFO) << "AudioDecoderAacImpl::DecodeInternal ret:" << ret;
   return ret;
 }
 
+void AudioDecoderAacImpl::PostDecodeAhead(std::shared_ptr<AacDecodeJob> job) {
+  std::shared_ptr<AacDecodeLink> link = decode_link_;
+  decode_thread_->PostTask(ToQueuedTask([link, job]() mutable {
+    MutexLock lock(&link->mutex);
+    if (link->decoder) {
+      link->decoder->DecodeAhead(std::move(job));
+    }
+  }));
+}
+
+void AudioDecoderAacImpl::DecodeAhead(std::shared_ptr<AacDecodeJob> job) {
+  MutexLock lock(&decode_mutex_);
+  if (job) {
+    // From before a Reset(), a duplicate or behind the decoder already:
+    // playout decodes it, if NetEq still wants it.
+    if (job->generation != generation_ ||
+        (has_last_decoded_ && !IsNewerTimestamp(job->timestamp, last_decoded_timestamp_))) {
+      return;
+    }
+    // Reordered on the network, it goes before the later ones queued.
+    auto it = pending_.end();
+    while (it != pending_.begin() && IsNewerTimestamp((*std::prev(it))->timestamp, job->timestamp)) {
+      --it;
+    }
+    pending_.insert(it, std::move(job));
+  }
+  DecodeContiguous();
+}
+
+void AudioDecoderAacImpl::DecodeContiguous() {
+  while (!pending_.empty()) {
+    std::shared_ptr<AacDecodeJob> job = pending_.front();
+    if (job->taken || job->released.load(std::memory_order_relaxed) ||
+        (has_last_decoded_ && !IsNewerTimestamp(job->timestamp, last_decoded_timestamp_))) {
+      // Decoded by playout, dropped by NetEq, or passed by playout.
+      pending_.pop_front();
+      continue;
+    }
+    // The decoder keeps state across frames. A gap waits for the packet
+    // reordered behind it, or for playout to decode past the loss.
+    if (has_last_decoded_ && !FollowsLastDecoded(*job)) {
+      return;
+    }
+    pending_.pop_front();
+
+    decode_scratch_.SetSize(kMaxDecodedSamples * init_param_.num_channels);
+    int64_t start_us = rtc::TimeMicros();
+    int ret = DecodeFrame(job->payload, decode_scratch_, &job->speech_type);
+    int64_t decode_us = rtc::TimeMicros() - start_us;
+    job->samples = ret;
+    job->pcm.SetData(decode_scratch_.data(), ret > 0 ? ret : 0);
+    job->taken = true;
+    has_last_decoded_ = true;
+    last_decoded_timestamp_ = job->timestamp;
+    last_decoded_duration_ = job->duration;
+    job->staged.store(true, std::memory_order_release);
+    if (sink_) {
+      sink_->OnAudioDecoded(decode_us, true);
+    }
+  }
+}
+
+bool AudioDecoderAacImpl::FollowsLastDecoded(const AacDecodeJob& job) const {
+  if (last_decoded_duration_ <= 0) {
+    return false;   // unknown framing, playout decodes in its own order
+  }
+  int32_t step = static_cast<int32_t>(job.timestamp - last_decoded_timestamp_);
+  return std::abs(step - last_decoded_duration_) <= kTimestampSlack;
+}
+
+int AudioDecoderAacImpl::DecodeStaged(AacDecodeJob& job,
+                                      rtc::ArrayView<int16_t> decoded,
+                                      SpeechType* speech_type) {
+  const bool late = !job.staged.load(std::memory_order_acquire);
+  // Waits here for the worker, if it is decoding this payload.
+  MutexLock lock(&decode_mutex_);
+  if (late && sink_) {
+    sink_->OnAudioDecodeLate();
+  }
+
+  if (job.staged.load(std::memory_order_relaxed) && job.generation == generation_) {
+    size_t samples = job.pcm.size();
+    if (samples > decoded.size()) {
+      RTC_LOG(LS_WARNING) << "[AAC]AudioDecoderAacImpl::DecodeStaged() " << samples
+                          << " samples staged, room for " << decoded.size();
+      samples = decoded.size();
+    }
+    std::copy(job.pcm.data(), job.pcm.data() + samples, decoded.data());
+    *speech_type = job.speech_type;
+    return job.samples > 0 ? static_cast<int>(samples) : job.samples;
+  }
+
+  // Not decoded ahead: past a loss the worker holds back at, or behind the
+  // decoder already. Decoding that on the decoder's state corrupts it, so
+  // the decoder restarts first and the frames staged after it stay.
+  const bool in_order = !has_last_decoded_ || IsNewerTimestamp(job.timestamp, last_decoded_timestamp_);
+  if (!in_order && sink_) {
+    RTC_LOG(LS_INFO) << "[AAC]AudioDecoderAacImpl::DecodeStaged() ts:" << job.timestamp
+                     << " behind last decoded ts:" << last_decoded_timestamp_ << ", decoder restarted.";
+    sink_->AudioDecoderInit(init_param_);
+  }
+  int64_t start_us = rtc::TimeMicros();
+  int ret = DecodeFrame(job.payload, decoded, speech_type);
+  int64_t decode_us = rtc::TimeMicros() - start_us;
+  job.taken = true;
+  if (in_order) {
+    has_last_decoded_ = true;
+    last_decoded_timestamp_ = job.timestamp;
+    last_decoded_duration_ = job.duration;
+  }
+  if (sink_) {
+    sink_->OnAudioDecoded(decode_us, false);
+  }
+  // What the worker held back may follow this decode now.
+  if (in_order && decode_thread_ && !pending_.empty()) {
+    PostDecodeAhead(nullptr);
+  }
+  return ret;
+}
+
+int AudioDecoderAacImpl::DecodeInternal(const uint8_t* encoded,
+                                        size_t encoded_len,
+                                        int sample_rate_hz,
+                                        int16_t* decoded,
+                                        SpeechType* speech_type) {
+  // Only reached through the legacy Decode(), which checked for room for
+  // PacketDuration(), all it can promise. NetEq decodes AacFrame.
+  int duration = PacketDuration(encoded, encoded_len);
+  size_t capacity = duration > 0 ? duration * init_param_.num_channels : 0;
+  MutexLock lock(&decode_mutex_);
+  return DecodeFrame(rtc::MakeArrayView(encoded, encoded_len),
+                     rtc::MakeArrayView(decoded, capacity), speech_type);
+}
+
 
 } // namespace webrtc
\ No newline at end of file
@@ -1,12 +1,21 @@
 #ifndef MODULES_AUDIO_CODING_CODECS_AUDIO_DECODER_AAC_H_
 #define MODULES_AUDIO_CODING_CODECS_AUDIO_DECODER_AAC_H_
 
+#include <atomic>
+#include <list>
+#include <memory>
+
 #include "api/audio_codecs/audio_decoder_sink.h"
 #include "api/audio_codecs/audio_decoder.h"
 #include "rtc_base/constructor_magic.h"
+#include "rtc_base/synchronization/mutex.h"
+#include "rtc_base/thread.h"
 #include <stdio.h>
 namespace webrtc {
 
+struct AacDecodeJob;
+struct AacDecodeLink;
+
 class AudioDecoderAacImpl : public AudioDecoder {
  public:
   AudioDecoderAacImpl(AudioDecoderSink* sink,
@@ -36,6 +45,25 @@ class AudioDecoderAacImpl : public AudioDecoder {
 
   void SetPacketSampleRateHz(int sample_rate_hz) { packet_sample_rate_hz_ = sample_rate_hz; }
 
+  // Decodes |encoded| without copying it, into at most decoded.size()
+  // samples. Returns the total number of samples across all channels, or a
+  // negative value on error. Every decode comes through here, playout, the
+  // decode thread and DecodeInternal() alike, so a subclass that does not
+  // decode through the sink overrides this.
+  virtual int DecodeFrame(rtc::ArrayView<const uint8_t> encoded,
+                          rtc::ArrayView<int16_t> decoded,
+                          SpeechType* speech_type);
+
+  // Decode thread. Queues |job|, if any, then decodes and stages what
+  // follows the last decode in timestamp order, holding back at a gap.
+  void DecodeAhead(std::shared_ptr<AacDecodeJob> job);
+  // Playout. Hands out the PCM staged for |job|, waiting for a decode in
+  // progress, or decodes it now, restarting the decoder if |job| is behind
+  // it. Returns as DecodeFrame().
+  int DecodeStaged(AacDecodeJob& job,
+                   rtc::ArrayView<int16_t> decoded,
+                   SpeechType* speech_type);
+
  protected:
   int DecodeInternal(const uint8_t* encoded,
                      size_t encoded_len,
@@ -44,11 +72,45 @@ class AudioDecoderAacImpl : public AudioDecoder {
                      SpeechType* speech_type) override;
 
  private:
+  // How much audio a packet carries, at the AAC core sample rate.
+  struct Framing {
+    int sample_rate_hz = 0;   // without SBR, 0 if unknown
+    int frame_samples = 1024; // per access unit, 960 with frameLengthFlag
+    int frames = 1;           // access units in the packet
+  };
+  // Reads the framing of |encoded| from its ADTS headers, from the in band
+  // StreamMuxConfig of a LOAS frame, or from the SDP config otherwise.
+  bool ParseFraming(const uint8_t* encoded, size_t encoded_len, Framing* framing) const;
+  void PostDecodeAhead(std::shared_ptr<AacDecodeJob> job);
+  void DecodeContiguous() RTC_EXCLUSIVE_LOCKS_REQUIRED(decode_mutex_);
+  bool FollowsLastDecoded(const AacDecodeJob& job) const RTC_EXCLUSIVE_LOCKS_REQUIRED(decode_mutex_);
+
   //const size_t channels_;
   //const int sample_rate_hz_;
   int packet_sample_rate_hz_;
   AudioDecoderSink* sink_;
   struct DecoderInitParam init_param_;
+  Framing config_framing_;              // LATM without in band config
+  mutable Framing loas_framing_;        // last in band StreamMuxConfig
+  mutable int last_packet_duration_;    // for packets that do not tell
+
+  // Decodes payloads on arrival, off the 10 ms playout tick, on a thread
+  // shared with the other decoders. Null if none started, everything is
+  // decoded by playout then.
+  rtc::Thread* decode_thread_;
+  // Cut by the destructor, so decodes still queued find no decoder.
+  std::shared_ptr<AacDecodeLink> decode_link_;
+  // Bumped by Reset(), what was staged before is decoded again.
+  std::atomic<uint32_t> generation_;
+  // Held across each decode, so the sink only decodes one payload at a time
+  // and playout waits for the worker's decode in progress.
+  Mutex decode_mutex_;
+  bool has_last_decoded_ RTC_GUARDED_BY(decode_mutex_);
+  uint32_t last_decoded_timestamp_ RTC_GUARDED_BY(decode_mutex_);
+  int last_decoded_duration_ RTC_GUARDED_BY(decode_mutex_);
+  // Arrived and not decoded yet, oldest first.
+  std::list<std::shared_ptr<AacDecodeJob>> pending_ RTC_GUARDED_BY(decode_mutex_);
+  rtc::BufferT<int16_t> decode_scratch_ RTC_GUARDED_BY(decode_mutex_);
   RTC_DISALLOW_COPY_AND_ASSIGN(AudioDecoderAacImpl);
 };
 
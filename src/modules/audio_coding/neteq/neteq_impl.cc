@@ -167,8 +167,7 @@ NetEqImpl::NetEqImpl(const NetEq::Config& config,
       latest_decoded_clock_ms_(0),
       first_packet_received_(false),
       first_packet_decoded_(false),
-      set_timstamp_interval_(false),
-      actual_fs_hz_set_(false) {
+      set_timstamp_interval_(false) {
   RTC_LOG(LS_INFO) << "NetEq config: " << config.ToString();
   int fs = config.sample_rate_hz;
   if (fs != 8000 && fs != 16000 && fs != 32000 && fs != 48000) {
@@ -210,79 +209,13 @@ int NetEqImpl::InsertPacket(const RTPHeader& rtp_header,
     }
   }
 
-  // deal with aac 44100 clockrate_hz
-  absl::optional<NetEq::DecoderFormat> format = absl::nullopt;
-  {
-    const DecoderDatabase::DecoderInfo* const di =
-        decoder_database_->GetDecoderInfo(header.payloadType);
-    if (di) {
-      const AudioDecoder* const decoder = di->GetDecoder();
-      // TODO(kwiberg): Why the special case for RED?
-      format = DecoderFormat{
-          /*sample_rate_hz=*/di->IsRed() ? 8000 : di->SampleRateHz(),
-          /*num_channels=*/
-          decoder ? rtc::dchecked_cast<int>(decoder->Channels()) : 1,
-          /*sdp_format=*/di->GetFormat()};
-    }
-  }
-  if (format && absl::EqualsIgnoreCase(format->sdp_format.name, "MP4A-ADTS")) {
-    // Parse adts
-    if (payload[0] == 0xff && ((payload[1] & 0xf0) == 0xf0)) {
-      int size = 0;
-      size |= ((payload[3] & 0x03) << 11);
-      size |= payload[4] << 3;
-      size |= ((payload[5] & 0xe0) >> 5);
-      uint8_t sampling_frequency_index = (payload[2] & 0x3c) >> 2;
-      int rtp_sample_rate = audio_sample_rates[sampling_frequency_index];
-      //RTC_LOG(LS_INFO) << "wbi NetEqImpl::InsertPacketInternal samplerate:" << rtp_sample_rate << " sampling_frequency_index:" << sampling_frequency_index << " size:" << size << " payload_size:" << payload.size();
-      if (rtp_sample_rate != 48000) {
-        uint32_t tmp = ((uint64_t)header.timestamp*48000)/rtp_sample_rate;
-        header.timestamp = tmp;
-        if (!actual_fs_hz_set_) {
-          red_payload_splitter_->SetActualClockRate(rtp_sample_rate);
-          actual_fs_hz_set_ = true;
-        }
-        //RTC_LOG(LS_INFO) << "wbi NetEqImpl::InsertPacketInternal rewrite timestamp:" << header.timestamp << " ori ts:" << rtp_header.timestamp;
-      }
-    } else {
-      // not adts aac frame
-    }
-  }
-
-  if (format && absl::EqualsIgnoreCase(format->sdp_format.name, "MP4A-LATM")) {
-    uint32_t rtp_sample_rate = 48000;
-    uint32_t channels = 2;
-
-    if (format->sdp_format.IsCPresented()) {
-      if (!ValidateLatm(const_cast<uint8_t*>(payload.data()), payload.size(), rtp_sample_rate, channels)) {
-        return kFail;
-      }    
-    }
-    else {
-      bool sbr_enabled = false;
-      bool ps_enabled = false;
-      rtc::BufferT<uint8_t> extra_data;
-      bool is_ok = format->sdp_format.GetInfoFromConfig(channels, rtp_sample_rate, 
-                                                        sbr_enabled, ps_enabled, extra_data);
-      if (!is_ok)
-        return kFail;     
-    }
-
-    if (!rtp_sample_rate) {
-      RTC_LOG(LS_ERROR) << "[LATM] ValidateLatm() find the rtp_sample_rate=0";
-      return kFail;
-    }
-
-    if (rtp_sample_rate != 48000) {
-      uint32_t tmp = ((uint64_t)header.timestamp * 48000) / rtp_sample_rate;
-      header.timestamp = tmp;
-      if (!actual_fs_hz_set_) {
-          red_payload_splitter_->SetActualClockRate(rtp_sample_rate);
-          actual_fs_hz_set_ = true;
-        }
-      //RTC_LOG(LS_INFO) << "wbi NetEqImpl::InsertPacketInternal rewrite timestamp:" << header.timestamp << " ori ts:" << rtp_header.timestamp;
-    }
+  // AAC timestamps tick at the stream's sample rate, scaled to 48 kHz in
+  // InsertPacketInternal().
+  uint32_t rtp_sample_rate = 0;
+  if (!GetAacClockRate(header.payloadType, payload, rtp_sample_rate)) {
+    return kFail;
   }
+  UpdateAacClock(rtp_sample_rate);
 
   if (!first_packet_received_) {
     first_packet_received_ = true;
@@ -414,6 +347,7 @@ void NetEqImpl::SetCodecs(const std::map<int, SdpAudioFormat>& codecs) {
   MutexLock lock(&mutex_);
   const std::vector<int> changed_payload_types =
       decoder_database_->SetCodecs(codecs);
+  aac_plans_.fill(AacPlan());
   for (const int pt : changed_payload_types) {
     packet_buffer_->DiscardPacketsWithPayloadType(pt, stats_.get());
   }
@@ -425,12 +359,14 @@ bool NetEqImpl::RegisterPayloadType(int rtp_payload_type,
                       << rtp_payload_type << ", codec "
                       << rtc::ToString(audio_format);
   MutexLock lock(&mutex_);
+  aac_plans_.fill(AacPlan());
   return decoder_database_->RegisterPayload(rtp_payload_type, audio_format) ==
          DecoderDatabase::kOK;
 }
 
 int NetEqImpl::RemovePayloadType(uint8_t rtp_payload_type) {
   MutexLock lock(&mutex_);
+  aac_plans_.fill(AacPlan());
   int ret = decoder_database_->Remove(rtp_payload_type);
   if (ret == DecoderDatabase::kOK || ret == DecoderDatabase::kDecoderNotFound) {
     packet_buffer_->DiscardPacketsWithPayloadType(rtp_payload_type,
@@ -442,6 +378,7 @@ int NetEqImpl::RemovePayloadType(uint8_t rtp_payload_type) {
 
 void NetEqImpl::RemoveAllPayloadTypes() {
   MutexLock lock(&mutex_);
+  aac_plans_.fill(AacPlan());
   decoder_database_->RemoveAll();
 }
 
@@ -698,11 +635,13 @@ int NetEqImpl::InsertPacketInternal(const RTPHeader& rtp_header,
   if (update_sample_rate_and_channels) {
     // Reset timestamp scaling.
     timestamp_scaler_->Reset();
+    aac_clock_.anchored = false;
   }
 
   if (!decoder_database_->IsRed(rtp_header.payloadType)) {
     // Scale timestamp to internal domain (only for some codecs).
     timestamp_scaler_->ToInternal(&packet_list);
+    ScaleAacTimestamps(&packet_list);
   }
 
   // Store these for later use, since the first packet may very well disappear
@@ -751,6 +690,13 @@ int NetEqImpl::InsertPacketInternal(const RTPHeader& rtp_header,
   // after RED splitting.
   if (decoder_database_->IsRed(rtp_header.payloadType)) {
     timestamp_scaler_->ToInternal(&packet_list);
+    // The primary block, split last, is at the front.
+    const Packet& primary = packet_list.front();
+    uint32_t rtp_clock_hz = 0;
+    if (GetAacClockRate(primary.payload_type, primary.payload, rtp_clock_hz)) {
+      UpdateAacClock(rtp_clock_hz);
+    }
+    ScaleAacTimestamps(&packet_list);
     main_timestamp = packet_list.front().timestamp;
     main_payload_type = packet_list.front().payload_type;
     main_sequence_number = packet_list.front().sequence_number;
@@ -2350,7 +2296,148 @@ int32_t NetEqImpl::CalcRtpTimestampInterval(int32_t seq, int32_t timestamp_rtp)
   return 0;
 }
 
+void NetEqImpl::UpdateAacClock(uint32_t rtp_clock_hz) {
+  if (rtp_clock_hz == 0 || rtp_clock_hz == aac_clock_.rtp_clock_hz) {
+    return;
+  }
+  RTC_LOG(LS_INFO) << "[AAC]NetEqImpl::UpdateAacClock() rtp clock:"
+                   << aac_clock_.rtp_clock_hz << " -> " << rtp_clock_hz;
+  aac_clock_.rtp_clock_hz = rtp_clock_hz;
+  aac_clock_.anchored = false;
+}
+
+absl::optional<uint32_t> NetEqImpl::MapRtpTimestamp(
+    uint32_t rtp_timestamp) const {
+  MutexLock lock(&mutex_);
+  const uint32_t rtp_clock_hz = aac_clock_.rtp_clock_hz;
+  if (rtp_clock_hz == 0 || rtp_clock_hz == 48000) {
+    return rtp_timestamp;
+  }
+  if (!aac_clock_.anchored) {
+    return absl::nullopt;
+  }
+  // The arithmetic of ScaleAacTimestamps, without moving the clock.
+  const int64_t since_anchor = aac_clock_.since_anchor +
+      static_cast<int32_t>(rtp_timestamp - aac_clock_.last_timestamp);
+  return aac_clock_.anchor_timestamp +
+      static_cast<uint32_t>(since_anchor * 48000 / rtp_clock_hz);
+}
+
+void NetEqImpl::ScaleAacTimestamps(PacketList* packet_list) {
+  const uint32_t rtp_clock_hz = aac_clock_.rtp_clock_hz;
+  if (rtp_clock_hz == 0 || rtp_clock_hz == 48000) {
+    return;
+  }
+  for (Packet& packet : *packet_list) {
+    if (!aac_clock_.anchored) {
+      aac_clock_.anchored = true;
+      aac_clock_.anchor_timestamp = packet.timestamp;
+      aac_clock_.last_timestamp = packet.timestamp;
+      aac_clock_.since_anchor = 0;
+    }
+    // Signed, so late and reordered packets step back.
+    aac_clock_.since_anchor +=
+        static_cast<int32_t>(packet.timestamp - aac_clock_.last_timestamp);
+    aac_clock_.last_timestamp = packet.timestamp;
+    packet.timestamp = aac_clock_.anchor_timestamp +
+        static_cast<uint32_t>(aac_clock_.since_anchor * 48000 / rtp_clock_hz);
+    // Kept in the clock of the audio frames they come out with.
+    const RtpPacketInfo& info = packet.packet_info;
+    packet.packet_info = RtpPacketInfo(
+        info.ssrc(), info.csrcs(), packet.timestamp, info.audio_level(),
+        info.absolute_capture_time(), info.receive_time());
+  }
+}
+
 #define LOAS_SYNC_WORD   0x2b7 
+bool NetEqImpl::GetAacClockRate(uint8_t payload_type,
+                                rtc::ArrayView<const uint8_t> payload,
+                                uint32_t& clock_rate_hz) {
+  clock_rate_hz = 0;
+  if (payload_type >= aac_plans_.size()) {
+    return true;
+  }
+  AacPlan& plan = aac_plans_[payload_type];
+  if (plan.kind == AacPlan::kUnknown) {
+    const DecoderDatabase::DecoderInfo* const di =
+        decoder_database_->GetDecoderInfo(payload_type);
+    if (!di) {
+      return true;   // not registered (yet), nothing to cache
+    }
+    const SdpAudioFormat& format = di->GetFormat();
+    plan.kind = AacPlan::kNotAac;
+    if (absl::EqualsIgnoreCase(format.name, "MP4A-ADTS")) {
+      plan.kind = AacPlan::kAdts;
+    } else if (absl::EqualsIgnoreCase(format.name, "MP4A-LATM")) {
+      if (format.IsCPresented()) {
+        plan.kind = AacPlan::kLatmInBand;
+      } else {
+        plan.kind = AacPlan::kLatmConfig;
+        uint32_t channels = 2;
+        uint32_t sample_rate = 48000;
+        bool sbr_enabled = false;
+        bool ps_enabled = false;
+        rtc::BufferT<uint8_t> extra_data;
+        if (!format.GetInfoFromConfig(channels, sample_rate, sbr_enabled,
+                                      ps_enabled, extra_data)) {
+          sample_rate = 0;
+        }
+        plan.clock_rate_hz = sample_rate;
+      }
+    }
+    RTC_LOG(LS_INFO) << "[AAC]NetEqImpl::GetAacClockRate() pt:"
+                     << static_cast<int>(payload_type) << " name:" << format.name
+                     << " plan:" << plan.kind;
+  }
+
+  switch (plan.kind) {
+    case AacPlan::kAdts:
+      if (payload.size() >= 3 && payload[0] == 0xff &&
+          (payload[1] & 0xf0) == 0xf0) {
+        clock_rate_hz = audio_sample_rates[(payload[2] & 0x3c) >> 2];
+      }
+      return true;
+    case AacPlan::kLatmConfig:
+      if (!plan.clock_rate_hz) {
+        RTC_LOG(LS_ERROR) << "[LATM] bad config, no rtp_sample_rate";
+        return false;
+      }
+      clock_rate_hz = plan.clock_rate_hz;
+      return true;
+    case AacPlan::kLatmInBand: {
+      const size_t config_end = AacPlan::kLoasConfigOffset + AacPlan::kLoasConfigSize;
+      // Only the frame length changes from one LOAS frame to the next as long
+      // as the config stays, skip validating it again then.
+      if (plan.clock_rate_hz && payload.size() >= config_end &&
+          memcmp(payload.data() + AacPlan::kLoasConfigOffset, plan.loas_config,
+                 AacPlan::kLoasConfigSize) == 0) {
+        clock_rate_hz = plan.clock_rate_hz;
+        return true;
+      }
+      uint32_t sample_rate = 48000;
+      uint32_t channels = 2;
+      plan.clock_rate_hz = 0;
+      if (!ValidateLatm(const_cast<uint8_t*>(payload.data()), payload.size(),
+                        sample_rate, channels)) {
+        return false;
+      }
+      if (!sample_rate) {
+        RTC_LOG(LS_ERROR) << "[LATM] ValidateLatm() find the rtp_sample_rate=0";
+        return false;
+      }
+      if (payload.size() >= config_end) {
+        memcpy(plan.loas_config, payload.data() + AacPlan::kLoasConfigOffset,
+               AacPlan::kLoasConfigSize);
+        plan.clock_rate_hz = sample_rate;
+      }
+      clock_rate_hz = sample_rate;
+      return true;
+    }
+    default:
+      return true;
+  }
+}
+
 bool NetEqImpl::ValidateLatm(uint8_t* data, uint32_t size, 
                              uint32_t& sample_rate, uint32_t &channels) {
   BitStreamReader reader;
@@ -11,6 +11,7 @@
 #ifndef MODULES_AUDIO_CODING_NETEQ_NETEQ_IMPL_H_
 #define MODULES_AUDIO_CODING_NETEQ_NETEQ_IMPL_H_
 
+#include <array>
 #include <map>
 #include <memory>
 #include <string>
@@ -184,6 +185,9 @@ class NetEqImpl : public webrtc::NetEq {
 
   absl::optional<uint32_t> GetPlayoutTimestamp() const override;
 
+  absl::optional<uint32_t> MapRtpTimestamp(
+      uint32_t rtp_timestamp) const override;
+
   int last_output_sample_rate_hz() const override;
 
   absl::optional<DecoderFormat> GetDecoderFormat(
@@ -353,6 +357,51 @@ class NetEqImpl : public webrtc::NetEq {
 
   int32_t CalcRtpTimestampInterval(int32_t seq, int32_t timestamp_rtp);
 
+  // RTP clock rate of an AAC payload, read through the payload type's
+  // AacPlan; 0 if the payload is not AAC or does not tell. Returns false if
+  // a LATM payload fails validation.
+  bool GetAacClockRate(uint8_t payload_type,
+                       rtc::ArrayView<const uint8_t> payload,
+                       uint32_t& clock_rate_hz)
+      RTC_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // How InsertPacket() reads the AAC headers of one payload type. Worked out
+  // from the decoder database on the first packet, dropped when the payload
+  // types change.
+  struct AacPlan {
+    enum Kind { kUnknown, kNotAac, kAdts, kLatmInBand, kLatmConfig };
+    // Bytes of a LOAS frame holding the StreamMuxConfig fields ValidateLatm()
+    // checks, after the sync word and frame length.
+    static constexpr size_t kLoasConfigOffset = 3;
+    static constexpr size_t kLoasConfigSize = 4;
+
+    Kind kind = kUnknown;
+    uint32_t clock_rate_hz = 0;   // kLatmConfig, and kLatmInBand once validated
+    uint8_t loas_config[kLoasConfigSize] = {0};   // last validated, kLatmInBand
+  };
+
+  // NetEq runs at 48 kHz for AAC whatever the stream's sample rate, which is
+  // also the RTP clock of AAC. Maps those timestamps to 48 kHz from the
+  // unwrapped distance to an anchor packet, so the mapping neither drifts
+  // nor breaks at a timestamp wrap, and a RED block lands on the same
+  // timestamp as its primary copy.
+  struct AacClock {
+    uint32_t rtp_clock_hz = 0;   // 0 until an AAC packet tells it
+    bool anchored = false;
+    uint32_t anchor_timestamp = 0;
+    uint32_t last_timestamp = 0;
+    int64_t since_anchor = 0;    // unwrapped, rtp_clock_hz
+  };
+
+  // Takes the RTP clock of the latest AAC packet, 0 if it did not tell.
+  void UpdateAacClock(uint32_t rtp_clock_hz)
+      RTC_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Scales the timestamps of |packet_list|, after RED splitting, from the
+  // AAC RTP clock to 48 kHz. Does nothing until the clock is known or if it
+  // is 48 kHz.
+  void ScaleAacTimestamps(PacketList* packet_list)
+      RTC_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   /*
    * class BitStreamReader is for stream mux config for big-endian
    */
@@ -404,6 +453,8 @@ class NetEqImpl : public webrtc::NetEq {
   };
 
   SMC smc_;
+  std::array<AacPlan, 128> aac_plans_ RTC_GUARDED_BY(mutex_);
+  AacClock aac_clock_ RTC_GUARDED_BY(mutex_);
 
   Clock* const clock_;
 
@@ -492,7 +543,6 @@ class NetEqImpl : public webrtc::NetEq {
   bool first_packet_decoded_;
   std::map<int32_t, int32_t> seq_timestamp_;
   bool set_timstamp_interval_;
-  bool actual_fs_hz_set_;
 
  private:
   RTC_DISALLOW_COPY_AND_ASSIGN(NetEqImpl);
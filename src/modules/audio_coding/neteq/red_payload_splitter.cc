@@ -126,12 +126,7 @@ bool RedPayloadSplitter::SplitRed(PacketList* packet_list) {
         }
 
         Packet new_packet;
-        if (clock_rate_ != 48000) {
-          uint32_t tmp = ((uint64_t)new_header.timestamp * 48000) / 44100;
-          new_packet.timestamp = tmp;
-        } else {
-          new_packet.timestamp = new_header.timestamp;
-        }
+        new_packet.timestamp = new_header.timestamp;
         new_packet.payload_type = new_header.payload_type;
         new_packet.sequence_number = red_packet.sequence_number - (red_packet.timestamp - new_header.timestamp)/timestamp_interval_;
         new_packet.priority.red_level =
@@ -46,11 +46,8 @@ class RedPayloadSplitter {
 
   virtual void SetTimestampInterval(int32_t interval);
 
-  virtual void SetActualClockRate(int32_t clock_rate) { clock_rate_ = clock_rate; }
-
  private:
   int32_t timestamp_interval_ = 960;
-  int32_t clock_rate_ = 48000;
   RTC_DISALLOW_COPY_AND_ASSIGN(RedPayloadSplitter);
 };
 
@@ -16,6 +16,7 @@
 
 #define RECV_STREAM_INFO_TIMEOUT 5000
 #define STREAM_INFO_QUERY_INTERVAL 10
+#define READ_FRAME_TIMEOUT 20 // ms, bounds how long an interrupt can go unnoticed
 #define RTD_DEFAULT_AUDIO_FRAME_SAMPLES 1024
 
 typedef struct RtdContext {
@@ -43,6 +44,10 @@ typedef struct RtdContext {
   struct RtdDemuxInfo stream_info;
   struct RtdApiFuncs* rtd_funcs;
   bool frame_dec_info_logged;
+  int interleave_max_skew;  // option, -1: video first
+  int audio_passthrough;    // option, 1: read encoded audio
+  int audio_packet_ms;      // option, 0: 10ms pcm packets
+  int max_buffer_ms;        // option, 0: no latency control
 } RtdContext;
 
 static int rtd_get_log_level() {
@@ -152,7 +157,7 @@ static int rtd_audio_decoder_init(void* obj, RtdAudioDecoderInitParam* init_para
   return 0;
 }
 
-static int rtd_audio_resample(RtdContext* rtd, uint8_t* buffer) {
+static int rtd_audio_resample(RtdContext* rtd, uint8_t* buffer, int capacity) {
   if (!rtd || !rtd->audio_frame) {
     return -1;
   }
@@ -203,8 +208,13 @@ static int rtd_audio_resample(RtdContext* rtd, uint8_t* buffer) {
     uint8_t* out_buffer[8] = { NULL };
     out_buffer[0] = buffer;
 
-    int dst_num_samples = av_rescale_rnd(swr_get_delay(rtd->audio_resample_ctx, rtd->out_sample_rate) + frame->nb_samples,
-                                         rtd->out_sample_rate, rtd->out_sample_rate, AV_ROUND_UP);
+    int dst_num_samples = av_rescale_rnd(swr_get_delay(rtd->audio_resample_ctx, dec_sample_rate) + frame->nb_samples,
+                                         rtd->out_sample_rate, dec_sample_rate, AV_ROUND_UP);
+    // What does not fit stays in the converter for the next frame.
+    int out_channels = av_get_channel_layout_nb_channels(rtd->out_channel_layout);
+    if (out_channels > 0 && dst_num_samples > capacity / out_channels) {
+      dst_num_samples = capacity / out_channels;
+    }
     samples = swr_convert(rtd->audio_resample_ctx,
                           out_buffer,
                           dst_num_samples,
@@ -241,7 +251,8 @@ static int rtd_audio_decoder_decode(void* obj, RtdAudioDecodedInfo* info, int16_
     return RTD_DEFAULT_AUDIO_FRAME_SAMPLES;
   }
 
-  rtd->audio_packet.data = info->encoded_data;
+  // Not refcounted, the decoder copies what it keeps.
+  rtd->audio_packet.data = (uint8_t*)info->encoded_data;
   rtd->audio_packet.size = info->encoded_size;
   if (avcodec_send_packet(rtd->audio_decoder_ctx, &rtd->audio_packet) == AVERROR(EAGAIN)) {
     av_log(NULL, AV_LOG_ERROR, "avcodec_send_packet failed\n");
@@ -293,7 +304,7 @@ static int rtd_audio_decoder_decode(void* obj, RtdAudioDecodedInfo* info, int16_
 
   rtd->out_channel_layout = info->dst_channels < 2 ? AV_CH_LAYOUT_MONO : AV_CH_LAYOUT_STEREO;
   int frame_samples = rtd->audio_frame->nb_samples;
-  int resample_samples = rtd_audio_resample(rtd, (uint8_t*)decoded);
+  int resample_samples = rtd_audio_resample(rtd, (uint8_t*)decoded, info->dst_capacity);
   if (resample_samples > 0) {
     frame_samples = resample_samples;
   }
@@ -364,6 +375,19 @@ static void set_stream_pts_info(AVStream *s, int pts_wrap_bits,
   s->pts_wrap_bits = pts_wrap_bits;
 }
 
+static enum AVCodecID rtd_audio_codec_id(int codec) {
+  switch (codec) {
+  case RTD_AUDIO_CODEC_AAC:
+    return AV_CODEC_ID_AAC;
+  case RTD_AUDIO_CODEC_AAC_LATM:
+    return AV_CODEC_ID_AAC_LATM;
+  case RTD_AUDIO_CODEC_OPUS:
+    return AV_CODEC_ID_OPUS;
+  default:
+    return AV_CODEC_ID_PCM_S16LE;
+  }
+}
+
 static int rtd_stream_info_init(AVFormatContext *s){
   if (!s)
     return AVERROR(EINVAL);
@@ -375,6 +399,13 @@ static int rtd_stream_info_init(AVFormatContext *s){
   rtd->video_stream_index = -1;
 
   if (rtd->stream_info.audio_enabled) {
+    struct RtdAudioCodecInfo codec_info = { 0 };  // RTD_AUDIO_CODEC_PCM_S16LE
+    if (rtd->audio_passthrough &&
+        rtd->rtd_funcs->command(rtd->rtd_handler, "getAudioCodecInfo", &codec_info) < 0) {
+      av_log(s, AV_LOG_ERROR, "get audio codec info failed!\n");
+      return AVERROR(EIO);
+    }
+
     int stream_index = s->nb_streams;
     AVStream *stream = avformat_new_stream(s, NULL);
     if (!stream) {
@@ -386,10 +417,20 @@ static int rtd_stream_info_init(AVFormatContext *s){
     set_stream_pts_info(stream, 64, 1, 1000);
     s->streams[stream_index]                        = stream;
     s->streams[stream_index]->need_parsing          = AVSTREAM_PARSE_NONE;
-    s->streams[stream_index]->codecpar->codec_id    = s->audio_codec_id = AV_CODEC_ID_PCM_S16LE;
+    s->streams[stream_index]->codecpar->codec_id    = s->audio_codec_id = rtd_audio_codec_id(codec_info.codec);
     s->streams[stream_index]->codecpar->channels    = rtd->stream_info.audio_channels;
     s->streams[stream_index]->codecpar->sample_rate = rtd->stream_info.audio_sample_rate;
-    s->streams[stream_index]->codecpar->format      = AV_SAMPLE_FMT_S16;
+    if (s->audio_codec_id == AV_CODEC_ID_PCM_S16LE) {
+      s->streams[stream_index]->codecpar->format    = AV_SAMPLE_FMT_S16;
+    } else if (codec_info.extradata_len > 0) {
+      int len = codec_info.extradata_len;
+      stream->codecpar->extradata = av_mallocz(len + AV_INPUT_BUFFER_PADDING_SIZE);
+      if (!stream->codecpar->extradata) {
+        return AVERROR(ENOMEM);
+      }
+      memcpy(stream->codecpar->extradata, codec_info.extradata, len);
+      stream->codecpar->extradata_size = len;
+    }
     rtd->audio_stream_index = stream_index;
   }
 
@@ -446,7 +487,10 @@ static int rtd_read_header(AVFormatContext *s){
   initialize(rtd);
   int ret = AVERROR(0);
 
-  rtd->rtd_funcs = GetRtdApiFuncs(0);
+  rtd->rtd_funcs = GetRtdApiFuncs(RTD_API_VERSION);
+  if (!rtd->rtd_funcs) {
+    rtd->rtd_funcs = GetRtdApiFuncs(0);
+  }
   if (!rtd->rtd_funcs) {
     av_log(s,AV_LOG_ERROR, "get rtd impl failed!\n");
     ret = AVERROR(EINVAL);
@@ -477,6 +521,22 @@ static int rtd_read_header(AVFormatContext *s){
     goto out;
   }
 
+  if (rtd->audio_passthrough) {
+    struct RtdAudioOutputConf output_conf = { RTD_AUDIO_OUTPUT_ENCODED };
+    if (rtd->rtd_funcs->version < 5 ||
+        rtd->rtd_funcs->command(rtd->rtd_handler, "setAudioOutput", &output_conf) < 0) {
+      av_log(s, AV_LOG_WARNING, "audio passthrough not supported, reading pcm\n");
+      rtd->audio_passthrough = 0;
+    }
+  }
+
+  if (rtd->audio_packet_ms > 0) {
+    struct RtdAudioPacketConf packet_conf = { rtd->audio_packet_ms };
+    if (rtd->rtd_funcs->command(rtd->rtd_handler, "setAudioPacketDuration", &packet_conf) < 0) {
+      av_log(s, AV_LOG_WARNING, "audio packet duration %d not supported, reading 10ms pcm\n", rtd->audio_packet_ms);
+    }
+  }
+
   int ret_open = rtd->rtd_funcs->open(rtd->rtd_handler, s->filename, "r");
   if (ret_open != RTD_ERROR_OPEN_SUCCESS) {
     av_log(s, AV_LOG_ERROR, "fail to open the link! error_code:%d\n", ret_open);
@@ -484,6 +544,20 @@ static int rtd_read_header(AVFormatContext *s){
     goto out;
   }
 
+  if (rtd->interleave_max_skew >= 0) {
+    struct RtdReadConf read_conf = { RTD_READ_INTERLEAVED, rtd->interleave_max_skew };
+    if (rtd->rtd_funcs->command(rtd->rtd_handler, "setReadMode", &read_conf) < 0) {
+      av_log(s, AV_LOG_WARNING, "interleaved read not supported, reading video first\n");
+    }
+  }
+
+  if (rtd->max_buffer_ms > 0) {
+    struct RtdLatencyConf latency_conf = { rtd->max_buffer_ms };
+    if (rtd->rtd_funcs->command(rtd->rtd_handler, "setLatencyControl", &latency_conf) < 0) {
+      av_log(s, AV_LOG_WARNING, "latency control not supported\n");
+    }
+  }
+
   for (int i = 0; i < RECV_STREAM_INFO_TIMEOUT / STREAM_INFO_QUERY_INTERVAL; i++) {
     if (ff_check_interrupt(&s->interrupt_callback)) {
      av_log(s, AV_LOG_INFO, "user interrupted\n");
@@ -514,6 +588,14 @@ out:
   return ret;
 }
 
+static void rtd_packet_buffer_free(void* opaque, uint8_t* data) {
+  // may run on any thread and after rtd_read_close, frames do not need the handle
+  const struct RtdApiFuncs* funcs = GetRtdApiFuncs(0);
+  if (funcs) {
+    funcs->free_frame((struct RtdFrame*)opaque, NULL);
+  }
+}
+
 static int rtd_read_packet(AVFormatContext *s, AVPacket *pkt) {
   if (!s)
     return AVERROR(EINVAL);
@@ -527,7 +609,11 @@ static int rtd_read_packet(AVFormatContext *s, AVPacket *pkt) {
 
   struct RtdFrame *frame = NULL;
   if (rtd->rtd_funcs) {
-    ret = rtd->rtd_funcs->read(&frame, rtd->rtd_handler);
+    if (rtd->rtd_funcs->version >= 1 && rtd->rtd_funcs->read_timed) {
+      ret = rtd->rtd_funcs->read_timed(rtd->rtd_handler, &frame, READ_FRAME_TIMEOUT);
+    } else {
+      ret = rtd->rtd_funcs->read(&frame, rtd->rtd_handler);
+    }
     if (ret < 0) {
       av_log(s, AV_LOG_ERROR, "read frame failed!\n");
       return AVERROR(EIO);
@@ -563,6 +649,25 @@ static int rtd_read_packet(AVFormatContext *s, AVPacket *pkt) {
   pkt->pts = frame->pts;
   pkt->duration = frame->duration;
     
+#if RTD_FRAME_PADDING_SIZE >= AV_INPUT_BUFFER_PADDING_SIZE
+  if (rtd->rtd_funcs->version >= 2) {
+    // hand the rtd frame buffer to FFmpeg, it goes back to rtd when the
+    // packet is unreferenced
+    AVBufferRef *buf = av_buffer_create(frame->buf, frame->size + AV_INPUT_BUFFER_PADDING_SIZE,
+                                        rtd_packet_buffer_free, frame, AV_BUFFER_FLAG_READONLY);
+    if (!buf) {
+      av_log(s, AV_LOG_ERROR, "create pkt buf out of memory!\n");
+      ret = AVERROR(ENOMEM);
+      goto out;
+    }
+
+    pkt->buf = buf;
+    pkt->data = buf->data;
+    pkt->size = frame->size;
+    return AVERROR(0);
+  }
+#endif
+
   AVBufferRef *buf = av_buffer_alloc(frame->size + AV_INPUT_BUFFER_PADDING_SIZE);
   if (!buf) {
     av_log(s, AV_LOG_ERROR, "alloc pkt buf out of memory!\n");
@@ -584,6 +689,14 @@ out:
 #define OFFSET(x) offsetof(RtdContext, x)
 #define DEC AV_OPT_FLAG_DECODING_PARAM
 static const AVOption ff_rtd_options[] = {
+  { "interleave_max_skew", "return audio/video by dts, waiting up to this many ms for the lagging media; -1 to read video first",
+    OFFSET(interleave_max_skew), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 5000, DEC },
+  { "audio_passthrough", "export the received AAC/Opus stream instead of decoded pcm",
+    OFFSET(audio_passthrough), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, DEC },
+  { "audio_packet_ms", "merge decoded pcm into packets of this many ms (e.g. the audio device period); 0 for 10ms",
+    OFFSET(audio_packet_ms), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 200, DEC },
+  { "max_buffer_ms", "drop the oldest queued media when more than this many ms is buffered; 0 to never drop",
+    OFFSET(max_buffer_ms), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 10000, DEC },
   { NULL }
 };
 
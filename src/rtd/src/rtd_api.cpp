@@ -1,5 +1,14 @@
 #include "rtd_api.h"
 #include "rtd_api_impl.h"
+#include "rtd_engine_interface.h"
+
+namespace {
+
+// Each prepared connection holds a peer connection factory and, by default,
+// a signaling thread.
+constexpr int kRtdMaxPrepared = 8;
+
+} // namespace
 
 #ifdef __cplusplus
 extern "C" {
@@ -68,23 +77,75 @@ int RtdReadFrame(struct RtdFrame** frame, void* handle) {
   return -1;
 }
 
+int RtdReadFrameTimed(void* handle, struct RtdFrame** frame, int timeout_ms) {
+  RtdApiImpl* rtd = static_cast<RtdApiImpl*>(handle);
+  if (rtd) {
+    return rtd->ReadFrame(*frame, timeout_ms);
+  }
+  return -1;
+}
+
+int RtdReadMediaFrame(void* handle, int media, struct RtdFrame** frame, int timeout_ms) {
+  RtdApiImpl* rtd = static_cast<RtdApiImpl*>(handle);
+  if (rtd) {
+    return rtd->ReadMediaFrame(media, *frame, timeout_ms);
+  }
+  return -1;
+}
+
 void RtdFreeFrame(struct RtdFrame* frame, void* handle) {
+  // The frame keeps its queue alive, |handle| may already be closed.
+  RtdDemuxer::FreeFrame(frame);
+}
+
+int RtdReadFrameBatch(void* handle, struct RtdFrame** frames, int max, int* count) {
+  *count = 0;
   RtdApiImpl* rtd = static_cast<RtdApiImpl*>(handle);
   if (rtd) {
-    rtd->FreeFrame(frame);
+    return rtd->ReadFrames(frames, max, count);
   }
+  return -1;
+}
+
+void RtdFreeFrameBatch(struct RtdFrame** frames, int count, void* handle) {
+  RtdDemuxer::FreeFrames(frames, count);
+}
+
+int RtdPrepare(int count, const struct RtdPrepareConf* conf) {
+  RTC_LOG(LS_INFO) << "RtdPrepare count:" << count;
+  if (count < 0 || count > kRtdMaxPrepared) {
+    return -1;
+  }
+  RtdPrepareConf prepare_conf = { RTD_AUDIO_OUTPUT_PCM, RTD_THREAD_OWN_SIGNALING };
+  if (conf) {
+    prepare_conf = *conf;
+  }
+  // Same values the demuxer keeps from "setAudioOutput"/"setThreadMode".
+  int audio_output = prepare_conf.audio_output == RTD_AUDIO_OUTPUT_ENCODED ? RTD_AUDIO_OUTPUT_ENCODED : RTD_AUDIO_OUTPUT_PCM;
+  int thread_mode = prepare_conf.thread_mode == RTD_THREAD_SHARED_SIGNALING ? RTD_THREAD_SHARED_SIGNALING : RTD_THREAD_OWN_SIGNALING;
+  RtdEngineInterface::Prepare(count, audio_output, thread_mode);
+  return 0;
 }
 
 const struct RtdApiFuncs* GetRtdApiFuncs(int version) {
   static RtdApiFuncs funcs;
+  if (version > RTD_API_VERSION) {
+    RTC_LOG(LS_ERROR) << "GetRtdApiFuncs unsupported version:" << version;
+    return nullptr;
+  }
   if (!funcs.create) {
-    funcs.version = 0;
+    funcs.version = RTD_API_VERSION;
     funcs.create = RtdCreate;
     funcs.open = RtdOpenStream;
     funcs.command = RtdCommand;
     funcs.close = RtdCloseStream;
     funcs.read = RtdReadFrame;
     funcs.free_frame = RtdFreeFrame;
+    funcs.read_timed = RtdReadFrameTimed;
+    funcs.read_media = RtdReadMediaFrame;
+    funcs.read_batch = RtdReadFrameBatch;
+    funcs.free_batch = RtdFreeFrameBatch;
+    funcs.prepare = RtdPrepare;
   }
   return &funcs;
 }
@@ -7,9 +7,14 @@
 extern "C" {
 #endif
 
+// Latest api version. Fields are only ever appended to RtdApiFuncs, check
+// 'version' before using a field added after version 0.
+// Version 5 added the "setAudioOutput" and "getAudioCodecInfo" commands.
+#define RTD_API_VERSION 6
+
 // Api functions to manipulate RTC streams
 typedef struct RtdApiFuncs {
-  int version; // used for validation, default 0.
+  int version; // version of the returned table, see RTD_API_VERSION
 
   /* create rtd instance
    * conf: configure parameters
@@ -30,6 +35,17 @@ typedef struct RtdApiFuncs {
   void (*close)(void* handle);
 
   /* runtime command (e.g. get/set parameters)
+   * "requestKeyFrame" (arg NULL) asks the sender for a key frame, e.g. after
+   * a decoder error
+   * "switch" (arg const char* url) moves the open stream to another url,
+   * keeping the connection; frames of the new stream start with bit 1 of
+   * RtdFrame.flag set
+   * "getStartupMetrics" (arg struct RtdStartupMetrics*) reports how long each
+   * startup phase of the open (or last switch) took
+   * "getStats" (arg struct RtdStats*) snapshots receive, jitter buffer,
+   * queue and audio decode statistics; cheap enough to poll every second
+   * "getAudioCodecInfo" (arg struct RtdAudioCodecInfo*) tells the codec and
+   * config of the audio frames read, once the stream info arrived
    * @return 0 for success, negative value for error
    */
   int (*command)(void* handle, const char* cmd, void* arg);
@@ -44,13 +60,57 @@ typedef struct RtdApiFuncs {
 
   /* free RtdFrame of current stream
    * handle to the stream returned by open
+   * since version 2 frames are independent: any number may be held, in any
+   * order, and freed from any thread, also after close. 'handle' is not
+   * dereferenced and may be NULL.
    */
   void (*free_frame)(struct RtdFrame* frame, void* handle);
+
+  /* read one frame, waiting up to timeout_ms for one to arrive instead of
+   * returning 'try later' right away. Since version 1.
+   * caller need free the returned frame
+   * return value: same as read
+   */
+  int (*read_timed)(void* handle, struct RtdFrame** frame, int timeout_ms);
+
+  /* read one frame of the given media only (RtdReadMedia), waiting up to
+   * timeout_ms (0 to return right away). Since version 3.
+   * An audio and a video consumer may each call this from their own thread,
+   * frames they hold do not block each other. Do not mix with read or
+   * read_timed on the same handle.
+   * return value: same as read
+   */
+  int (*read_media)(void* handle, int media, struct RtdFrame** frame, int timeout_ms);
+
+  /* read every queued frame, up to max, into frames[0..*count). Since
+   * version 4.
+   * caller need free the returned frames, see free_batch
+   * return value: 0 if *count > 0; 1 for try later; negative value for
+   *               error
+   */
+  int (*read_batch)(void* handle, struct RtdFrame** frames, int max, int* count);
+
+  /* free count frames returned by read/read_batch in one call. Same rules as
+   * free_frame. Since version 4.
+   */
+  void (*free_batch)(struct RtdFrame** frames, int count, void* handle);
+
+  /* keep count peer connections, offer included, ready for the next opens,
+   * which then only run signaling and ICE. Since version 6.
+   * Connections are made in the background and replaced as opens take
+   * them; only opens with the settings in conf use them. The signaling
+   * server is connected to ahead as well.
+   * count: 0 releases them
+   * conf:  NULL for the defaults (pcm audio, own signaling thread)
+   * return value: 0 for success, negative value for error
+   */
+  int (*prepare)(int count, const struct RtdPrepareConf* conf);
 } RtdApiFuncs;
 
 /* @brief Query Rtd Api functions
  * @param version    Specify compatible api version, default:0
- * @return Structure containing Api function pointers
+ * @return Structure containing Api function pointers, NULL if 'version' is
+ *         newer than this library
  */
 RTD_API const struct RtdApiFuncs* GetRtdApiFuncs(int version);
 
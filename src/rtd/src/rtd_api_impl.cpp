@@ -8,6 +8,8 @@ RtdApiImpl::RtdApiImpl(RtdConf conf)
       demuxer_(nullptr) {
   InitLog(conf_);
   RTC_LOG(LS_INFO) << "RtdApiImpl::RtdApiImpl().";
+  // Created here so the commands that only apply before open() reach it.
+  demuxer_.reset(new RtdDemuxer(conf_));
 }
 
 RtdApiImpl::~RtdApiImpl() {
@@ -19,7 +21,10 @@ RtdApiImpl::~RtdApiImpl() {
 
 bool RtdApiImpl::Initialize() {
   RTC_LOG(LS_INFO) << "RtdApiImpl::Initialize().";
-  demuxer_.reset(new RtdDemuxer(conf_));
+  // Keeps the demuxer of create(), with what was set on it before open().
+  if (!demuxer_) {
+    demuxer_.reset(new RtdDemuxer(conf_));
+  }
   if (!demuxer_) {
     RTC_LOG(LS_ERROR) << "initialize failed, create demuxer error.";
     return false;
@@ -61,17 +66,32 @@ int RtdApiImpl::ReadFrame(RtdFrame*& frame) {
   return 0;
 }
 
-void RtdApiImpl::FreeFrame(RtdFrame* frame) {
+int RtdApiImpl::ReadFrame(RtdFrame*& frame, int timeout_ms) {
   if (demuxer_) {
-    demuxer_->FreeFrame(frame);
+    return demuxer_->ReadFrame(frame, timeout_ms);
   }
+  return 0;
+}
+
+int RtdApiImpl::ReadMediaFrame(int media, RtdFrame*& frame, int timeout_ms) {
+  if (demuxer_) {
+    return demuxer_->ReadMediaFrame(media, frame, timeout_ms);
+  }
+  return 0;
+}
+
+int RtdApiImpl::ReadFrames(RtdFrame** frames, int max_count, int* count) {
+  if (demuxer_) {
+    return demuxer_->ReadFrames(frames, max_count, count);
+  }
+  return 1;
 }
 
 int RtdApiImpl::Command(const char* cmd, void* arg) {
   if (demuxer_) {
     return demuxer_->Command(cmd, arg);
   }
-  return 0;
+  return -1;
 }
 
 void RtdApiImpl::InitLog(RtdConf conf) {
@@ -19,7 +19,10 @@ class RtdApiImpl {
   bool Stop();
 
   int ReadFrame(RtdFrame*& frame);
-  void FreeFrame(RtdFrame* frame);
+  // Blocks up to |timeout_ms| until a frame is available.
+  int ReadFrame(RtdFrame*& frame, int timeout_ms);
+  int ReadMediaFrame(int media, RtdFrame*& frame, int timeout_ms);
+  int ReadFrames(RtdFrame** frames, int max_count, int* count);
   // set/get parameters
   int Command(const char* cmd, void* arg);
 
@@ -1,19 +1,48 @@
 #include "rtd_audio_decoder_factory.h"
+#include <string.h>
+#include <algorithm>
 #include "absl/strings/match.h"
 #include "modules/audio_coding/codecs/aac/audio_decoder_aac.h"
 #include "modules/audio_coding/codecs/opus/audio_decoder_opus.h"
 #include "rtc_base/logging.h"
 #include "rtd_def.h"
 
+namespace {
+
+constexpr int kRtdPassthroughClockKhz = 48;     // NetEq timestamps of AAC and Opus
+constexpr int kRtdOpusDefaultFrameSamples = 960;  // 20ms at 48kHz
+constexpr int kRtdAacFrameSamples = 1024;
+
+// Skips the PayloadLengthInfo of an AudioMuxElement sent without in band
+// config (cpresent=0), leaving the access unit.
+bool SkipLatmPayloadLength(const uint8_t*& data, size_t& size) {
+  size_t length = 0;
+  size_t offset = 0;
+  uint8_t byte = 0xff;
+  while (byte == 0xff && offset < size) {
+    byte = data[offset++];
+    length += byte;
+  }
+  if (byte == 0xff || length > size - offset) {
+    return false;
+  }
+  data += offset;
+  size = length;
+  return true;
+}
+
+} // namespace
+
 namespace webrtc {
 namespace rtd {
 
 class AudioDecoderOpusExternal final : public AudioDecoderOpusImpl {
  public:
-  AudioDecoderOpusExternal(AudioFrameCallback* callback, int num_channels, int clockrate_hz)
+  AudioDecoderOpusExternal(AudioFrameCallback* callback, int num_channels, int clockrate_hz, bool passthrough)
       : AudioDecoderOpusImpl(num_channels, clockrate_hz),
-        decoded_callback_(callback) {
-    RTC_LOG(LS_INFO) << "AudioDecoderOpusExternal::AudioDecoderOpusExternal()";
+        decoded_callback_(callback),
+        passthrough_(passthrough) {
+    RTC_LOG(LS_INFO) << "AudioDecoderOpusExternal::AudioDecoderOpusExternal() passthrough:" << passthrough_;
   }
 
   ~AudioDecoderOpusExternal() override {
@@ -26,8 +55,57 @@ class AudioDecoderOpusExternal final : public AudioDecoderOpusImpl {
     }
   }
 
+  std::vector<ParseResult> ParsePayload(rtc::Buffer&& payload,
+                                        uint32_t timestamp) override {
+    if (passthrough_ && decoded_callback_ != nullptr && !payload.empty()) {
+      int samples = PacketDuration(payload.data(), payload.size());
+      decoded_callback_->OnEncodedAudioFrame(payload.data(), payload.size(), timestamp,
+                                             samples > 0 ? samples / kRtdPassthroughClockKhz : 0);
+    }
+    return AudioDecoderOpusImpl::ParsePayload(std::move(payload), timestamp);
+  }
+
+ protected:
+  int DecodeInternal(const uint8_t* encoded,
+                     size_t encoded_len,
+                     int sample_rate_hz,
+                     int16_t* decoded,
+                     SpeechType* speech_type) override {
+    if (!passthrough_) {
+      return AudioDecoderOpusImpl::DecodeInternal(encoded, encoded_len, sample_rate_hz,
+                                                  decoded, speech_type);
+    }
+    return DecodeSilence(encoded, encoded_len, decoded, speech_type);
+  }
+
+  int DecodeRedundantInternal(const uint8_t* encoded,
+                              size_t encoded_len,
+                              int sample_rate_hz,
+                              int16_t* decoded,
+                              SpeechType* speech_type) override {
+    if (!passthrough_) {
+      return AudioDecoderOpusImpl::DecodeRedundantInternal(encoded, encoded_len, sample_rate_hz,
+                                                           decoded, speech_type);
+    }
+    return DecodeSilence(encoded, encoded_len, decoded, speech_type);
+  }
+
  private:
+  // The packet already went out encoded, only keep NetEq's timeline going.
+  int DecodeSilence(const uint8_t* encoded, size_t encoded_len,
+                    int16_t* decoded, SpeechType* speech_type) {
+    int samples = PacketDuration(encoded, encoded_len);
+    if (samples <= 0) {
+      samples = kRtdOpusDefaultFrameSamples;
+    }
+    samples *= static_cast<int>(Channels());
+    memset(decoded, 0, samples * sizeof(int16_t));
+    *speech_type = kSpeech;
+    return samples;
+  }
+
   AudioFrameCallback* decoded_callback_;
+  const bool passthrough_;
   RTC_DISALLOW_COPY_AND_ASSIGN(AudioDecoderOpusExternal);
 };
 
@@ -42,8 +120,10 @@ class AudioDecoderAacExternal final : public AudioDecoderAacImpl {
                           bool sbr_enabled,
                           bool ps_enabled,
                           uint8_t* extra_data,
-                          int extra_data_len)
-    : AudioDecoderAacImpl(sink, num_channels, 
+                          int extra_data_len,
+                          bool passthrough,
+                          bool strip_mux_length)
+    : AudioDecoderAacImpl(passthrough ? nullptr : sink, num_channels, 
                           dec_hz,
                           clockrate_hz,
                           use_latm,
@@ -51,8 +131,13 @@ class AudioDecoderAacExternal final : public AudioDecoderAacImpl {
                           ps_enabled,
                           extra_data, 
                           extra_data_len),
-                          decoded_callback_(callback) {
-    RTC_LOG(LS_INFO) << "AudioDecoderAacExternal::AudioDecoderAacExternal() num_channels:" << num_channels << " clockrate_hz:" << clockrate_hz;
+                          decoded_callback_(callback),
+                          passthrough_(passthrough),
+                          strip_mux_length_(strip_mux_length),
+                          frame_samples_(sbr_enabled ? kRtdAacFrameSamples * 2 : kRtdAacFrameSamples),
+                          frame_duration_ms_(dec_hz > 0 ? frame_samples_ * 1000 / dec_hz : 0) {
+    RTC_LOG(LS_INFO) << "AudioDecoderAacExternal::AudioDecoderAacExternal() num_channels:" << num_channels << " clockrate_hz:" << clockrate_hz
+                     << " passthrough:" << passthrough_;
   }
 
   ~AudioDecoderAacExternal() override {
@@ -65,15 +150,57 @@ class AudioDecoderAacExternal final : public AudioDecoderAacImpl {
     }
   }
 
+  std::vector<ParseResult> ParsePayload(rtc::Buffer&& payload,
+                                        uint32_t timestamp) override {
+    if (passthrough_ && decoded_callback_ != nullptr) {
+      const uint8_t* data = payload.data();
+      size_t size = payload.size();
+      if (strip_mux_length_ && !SkipLatmPayloadLength(data, size)) {
+        RTC_LOG(LS_WARNING) << "[AAC][LATM] bad PayloadLengthInfo, size:" << payload.size();
+      } else if (size > 0) {
+        int duration_ms = PacketDuration(payload.data(), payload.size()) / kRtdPassthroughClockKhz;
+        if (duration_ms == 0) {
+          duration_ms = frame_duration_ms_;
+        }
+        decoded_callback_->OnEncodedAudioFrame(data, size, timestamp, duration_ms);
+      }
+    }
+    return AudioDecoderAacImpl::ParsePayload(std::move(payload), timestamp);
+  }
+
+ protected:
+  int DecodeFrame(rtc::ArrayView<const uint8_t> encoded,
+                  rtc::ArrayView<int16_t> decoded,
+                  SpeechType* speech_type) override {
+    if (!passthrough_) {
+      return AudioDecoderAacImpl::DecodeFrame(encoded, decoded, speech_type);
+    }
+    // The frame already went out encoded, only keep NetEq's timeline going:
+    // as many samples as the packet spans at the decoder's output rate.
+    int span = PacketDuration(encoded.data(), encoded.size());
+    int samples = span > 0 ? static_cast<int>(static_cast<int64_t>(span) * SampleRateHz() /
+                                              (kRtdPassthroughClockKhz * 1000))
+                           : frame_samples_;
+    size_t total = std::min(static_cast<size_t>(samples) * Channels(), decoded.size());
+    memset(decoded.data(), 0, total * sizeof(int16_t));
+    *speech_type = kSpeech;
+    return static_cast<int>(total);
+  }
+
  private:
   AudioFrameCallback* decoded_callback_;
+  const bool passthrough_;
+  const bool strip_mux_length_;   // LATM without in band config
+  const int frame_samples_;
+  const int frame_duration_ms_;
   RTC_DISALLOW_COPY_AND_ASSIGN(AudioDecoderAacExternal);
 };
 
-RtdAudioDecoderFactory::RtdAudioDecoderFactory(AudioFrameCallback* callback, AudioDecoderSink* sink)
+RtdAudioDecoderFactory::RtdAudioDecoderFactory(AudioFrameCallback* callback, AudioDecoderSink* sink, bool passthrough)
     : decoded_callback_(callback),
-      sink_(sink) {
-  RTC_LOG(LS_INFO) << "RtdAudioDecoderFactory::RtdAudioDecoderFactory()";
+      sink_(sink),
+      passthrough_(passthrough) {
+  RTC_LOG(LS_INFO) << "RtdAudioDecoderFactory::RtdAudioDecoderFactory() passthrough:" << passthrough_;
 }
 
 RtdAudioDecoderFactory::~RtdAudioDecoderFactory() {
@@ -110,7 +237,7 @@ RtdAudioDecoderFactory::MakeAudioDecoder(const SdpAudioFormat& format,
                    << " clockrate_hz:" << format.clockrate_hz;
 
   if (absl::EqualsIgnoreCase(format.name, "opus")) {
-    return std::make_unique<AudioDecoderOpusExternal>(decoded_callback_, format.num_channels, format.clockrate_hz);
+    return std::make_unique<AudioDecoderOpusExternal>(decoded_callback_, format.num_channels, format.clockrate_hz, passthrough_);
   } else if (absl::EqualsIgnoreCase(format.name, "MP4A-ADTS")) {
     return std::make_unique<AudioDecoderAacExternal>(decoded_callback_, 
                                                      sink_, 
@@ -118,7 +245,8 @@ RtdAudioDecoderFactory::MakeAudioDecoder(const SdpAudioFormat& format,
                                                      format.clockrate_hz,
                                                      format.clockrate_hz,
                                                      false, false, false,
-                                                     nullptr, 0);
+                                                     nullptr, 0,
+                                                     passthrough_, false);
   } else if (absl::EqualsIgnoreCase(format.name, "MP4A-LATM")) {
     uint32_t channnel = format.num_channels;
     uint32_t dec_hz = format.clockrate_hz;
@@ -158,7 +286,8 @@ RtdAudioDecoderFactory::MakeAudioDecoder(const SdpAudioFormat& format,
     return std::make_unique<AudioDecoderAacExternal>(decoded_callback_, sink_, channnel, 
                                                      dec_hz, clockrate_hz,
                                                      is_cprsented, sbr_enabled, ps_enabled,
-                                                     extra_data.data(), extra_data.size());
+                                                     extra_data.data(), extra_data.size(),
+                                                     passthrough_, !is_cprsented);
   }
 
   return nullptr;
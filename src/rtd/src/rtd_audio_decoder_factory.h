@@ -13,6 +13,10 @@ namespace rtd {
 class AudioFrameCallback {
  public:
   virtual int OnAudioFrame(AudioFrame* frame) = 0;
+  // Encoded output only: one access unit as it enters NetEq. |timestamp| is
+  // the NetEq RTP timestamp, 48 kHz for AAC and Opus.
+  virtual void OnEncodedAudioFrame(const uint8_t* data, size_t size,
+                                   uint32_t timestamp, int duration_ms) = 0;
 
  protected:
   virtual ~AudioFrameCallback() {}
@@ -20,7 +24,9 @@ class AudioFrameCallback {
 
 class RtdAudioDecoderFactory : public AudioDecoderFactory {
  public:
-  RtdAudioDecoderFactory(AudioFrameCallback* callback, AudioDecoderSink* sink);
+  // With |passthrough| decoders hand payloads to OnEncodedAudioFrame() and
+  // feed NetEq silence instead of decoding.
+  RtdAudioDecoderFactory(AudioFrameCallback* callback, AudioDecoderSink* sink, bool passthrough = false);
 
   ~RtdAudioDecoderFactory() override;
 
@@ -33,6 +39,7 @@ class RtdAudioDecoderFactory : public AudioDecoderFactory {
  private:
   AudioFrameCallback* decoded_callback_;
   AudioDecoderSink* sink_;
+  bool passthrough_;
 };
 
 } // namespace rtd
@@ -0,0 +1,73 @@
+#include "rtd_audio_decoder_factory.h"
+
+#include <vector>
+
+#include "test/gtest.h"
+
+namespace webrtc {
+namespace rtd {
+namespace {
+
+constexpr size_t kChannels = 2;
+constexpr int kSampleRateHz = 48000;
+constexpr int kAacFrameSamples = 1024;
+
+class EncodedFrameCounter : public AudioFrameCallback {
+ public:
+  int OnAudioFrame(AudioFrame* frame) override { return 0; }
+  void OnEncodedAudioFrame(const uint8_t* data, size_t size,
+                           uint32_t timestamp, int duration_ms) override {
+    ++frames;
+    last_size = size;
+    last_duration_ms = duration_ms;
+  }
+
+  int frames = 0;
+  size_t last_size = 0;
+  int last_duration_ms = 0;
+};
+
+// One ADTS frame: AAC LC, 48 kHz, stereo, one raw data block.
+std::vector<uint8_t> MakeAdtsFrame() {
+  constexpr size_t kFrameLength = 17;
+  std::vector<uint8_t> frame(kFrameLength, 0);
+  frame[0] = 0xff;
+  frame[1] = 0xf1;
+  frame[2] = 0x4c;   // LC, sampling index 3, channel config high bit
+  frame[3] = 0x80;   // channel config 2
+  frame[4] = static_cast<uint8_t>(kFrameLength >> 3);
+  frame[5] = static_cast<uint8_t>(((kFrameLength & 0x7) << 5) | 0x1f);
+  frame[6] = 0xfc;   // one raw data block
+  return frame;
+}
+
+TEST(RtdAudioDecoderFactoryTest, AacPassthroughFeedsNetEqAFrameOfSilence) {
+  EncodedFrameCounter callback;
+  RtdAudioDecoderFactory factory(&callback, nullptr, true);
+  std::unique_ptr<AudioDecoder> decoder =
+      factory.MakeAudioDecoder(SdpAudioFormat("MP4A-ADTS", kSampleRateHz, kChannels), absl::nullopt);
+  ASSERT_TRUE(decoder);
+
+  std::vector<uint8_t> adts = MakeAdtsFrame();
+  std::vector<AudioDecoder::ParseResult> results =
+      decoder->ParsePayload(rtc::Buffer(adts.data(), adts.size()), 4800);
+  ASSERT_EQ(1u, results.size());
+  EXPECT_EQ(1, callback.frames);
+  EXPECT_EQ(adts.size(), callback.last_size);
+  EXPECT_EQ(kAacFrameSamples * 1000 / kSampleRateHz, callback.last_duration_ms);
+  EXPECT_EQ(static_cast<size_t>(kAacFrameSamples), results[0].frame->Duration());
+
+  std::vector<int16_t> decoded(5760 * kChannels, 1);
+  absl::optional<AudioDecoder::EncodedAudioFrame::DecodeResult> result =
+      results[0].frame->Decode(decoded);
+  ASSERT_TRUE(result);
+  EXPECT_EQ(kAacFrameSamples * kChannels, result->num_decoded_samples);
+  EXPECT_EQ(AudioDecoder::kSpeech, result->speech_type);
+  for (size_t i = 0; i < result->num_decoded_samples; ++i) {
+    ASSERT_EQ(0, decoded[i]);
+  }
+}
+
+} // namespace
+} // namespace rtd
+} // namespace webrtc
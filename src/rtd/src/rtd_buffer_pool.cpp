@@ -0,0 +1,85 @@
+#include "rtd_buffer_pool.h"
+#include "rtc_base/logging.h"
+
+namespace webrtc {
+namespace rtd {
+
+constexpr size_t RtdBufferPool::kNumClasses;
+constexpr size_t RtdBufferPool::kMaxCachedPerClass;
+
+RtdBufferPool::RtdBufferPool(size_t min_size)
+    : min_size_(min_size > 0 ? min_size : 1),
+      allocated_bytes_(0),
+      cached_bytes_(0) {
+  for (auto& free_list : free_lists_) {
+    free_list.reserve(kMaxCachedPerClass);
+  }
+}
+
+RtdBufferPool::~RtdBufferPool() {
+  RTC_LOG(LS_INFO) << "RtdBufferPool::~RtdBufferPool() allocated_bytes:" << AllocatedBytes()
+                   << " cached_bytes:" << CachedBytes();
+  for (auto& free_list : free_lists_) {
+    for (rtc::Buffer* buffer : free_list) {
+      delete buffer;
+    }
+  }
+}
+
+size_t RtdBufferPool::ClassOf(size_t bytes) const {
+  size_t index = 0;
+  while (index < kNumClasses && ClassSize(index) < bytes) {
+    ++index;
+  }
+  return index;
+}
+
+rtc::Buffer* RtdBufferPool::Acquire(size_t bytes) {
+  size_t index = ClassOf(bytes);
+  if (index < kNumClasses && !free_lists_[index].empty()) {
+    rtc::Buffer* buffer = free_lists_[index].back();
+    free_lists_[index].pop_back();
+    cached_bytes_.fetch_sub(buffer->capacity(), std::memory_order_relaxed);
+    buffer->Clear();
+    return buffer;
+  }
+
+  size_t capacity = index < kNumClasses ? ClassSize(index) : bytes;
+  rtc::Buffer* buffer = new rtc::Buffer();
+  buffer->EnsureCapacity(capacity);
+  allocated_bytes_.fetch_add(buffer->capacity(), std::memory_order_relaxed);
+  return buffer;
+}
+
+void RtdBufferPool::Release(rtc::Buffer* buffer) {
+  if (!buffer) {
+    return;
+  }
+
+  size_t capacity = buffer->capacity();
+  size_t index = ClassOf(capacity);
+  if (index < kNumClasses && ClassSize(index) == capacity &&
+      free_lists_[index].size() < kMaxCachedPerClass) {
+    free_lists_[index].push_back(buffer);
+    cached_bytes_.fetch_add(capacity, std::memory_order_relaxed);
+    return;
+  }
+
+  allocated_bytes_.fetch_sub(capacity, std::memory_order_relaxed);
+  delete buffer;
+}
+
+bool RtdBufferPool::Fits(const rtc::Buffer* buffer, size_t bytes) const {
+  if (!buffer || buffer->capacity() < bytes) {
+    return false;
+  }
+  size_t index = ClassOf(bytes);
+  if (index == kNumClasses) {
+    // Oversized frames get an exact buffer, reuse it only for the same class.
+    return ClassOf(buffer->capacity()) == kNumClasses;
+  }
+  return buffer->capacity() == ClassSize(index);
+}
+
+} // namespace rtd
+} // namespace webrtc
@@ -0,0 +1,57 @@
+#ifndef RTD_BUFFER_POOL_H_
+#define RTD_BUFFER_POOL_H_
+
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+#include "rtc_base/buffer.h"
+
+namespace webrtc {
+namespace rtd {
+
+// Size-class (slab) pool of rtc::Buffer. Class i holds buffers with a capacity
+// of |min_size| << i, so a frame gets a buffer at most twice its size instead
+// of a worst-case one. Released buffers are cached per class and handed out
+// again for frames of the same class.
+//
+// Acquire() and Release() must be called from a single thread (the queue
+// producer). The footprint getters may be called from any thread.
+class RtdBufferPool {
+ public:
+  static constexpr size_t kNumClasses = 12;
+  static constexpr size_t kMaxCachedPerClass = 8;
+
+  explicit RtdBufferPool(size_t min_size);
+  ~RtdBufferPool();
+
+  // Returns an empty buffer with capacity for at least |bytes|.
+  rtc::Buffer* Acquire(size_t bytes);
+
+  // Returns |buffer| to its class, or deletes it if the class is full or the
+  // buffer is larger than the largest class. Accepts nullptr.
+  void Release(rtc::Buffer* buffer);
+
+  // True if |buffer| is in the size class that Acquire(|bytes|) would use.
+  bool Fits(const rtc::Buffer* buffer, size_t bytes) const;
+
+  // Bytes allocated by the pool, whether handed out or cached.
+  size_t AllocatedBytes() const { return allocated_bytes_.load(std::memory_order_relaxed); }
+  // Bytes sitting in the per-class caches.
+  size_t CachedBytes() const { return cached_bytes_.load(std::memory_order_relaxed); }
+
+ private:
+  // Returns kNumClasses for sizes above the largest class.
+  size_t ClassOf(size_t bytes) const;
+  size_t ClassSize(size_t index) const { return min_size_ << index; }
+
+  const size_t min_size_;
+  std::vector<rtc::Buffer*> free_lists_[kNumClasses];
+  std::atomic<size_t> allocated_bytes_;
+  std::atomic<size_t> cached_bytes_;
+};
+
+} // namespace rtd
+} // namespace webrtc
+
+#endif // !RTD_BUFFER_POOL_H_
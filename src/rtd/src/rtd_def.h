@@ -38,6 +38,11 @@ extern "C" {
 #define RTD_ERROR_MEDIA_STREAM_STOPPED      (RTD_ERROR_BASE + 602)
 
 #define RTD_HEADER_LEN 1024
+#define RTD_AUDIO_EXTRADATA_LEN 64
+
+// RtdFrame::buf is followed by at least this many zero bytes, enough to hand
+// the buffer to FFmpeg without copying (AV_INPUT_BUFFER_PADDING_SIZE).
+#define RTD_FRAME_PADDING_SIZE 64
 
 typedef enum RtdMessageType {
   RTD_MSG_OFFER_SDP,
@@ -72,22 +77,164 @@ typedef struct RtdDemuxInfo {
   unsigned char spspps[RTD_HEADER_LEN]; // large enough
 } RtdDemuxInfo;
 
+typedef enum RtdAudioCodec {
+  RTD_AUDIO_CODEC_PCM_S16LE = 0,  // decoded audio, 10ms per frame (default)
+  RTD_AUDIO_CODEC_AAC,            // ADTS frames, or raw access units with the
+                                  // AudioSpecificConfig in extradata
+  RTD_AUDIO_CODEC_AAC_LATM,       // LOAS/LATM frames, config in band
+  RTD_AUDIO_CODEC_OPUS,           // Opus packets, OpusHead in extradata
+} RtdAudioCodec;
+
+// audio codec of the frames read, since api version 5
+// use command(..., "getAudioCodecInfo", RtdAudioCodecInfo*) once the stream
+// info arrived
+typedef struct RtdAudioCodecInfo {
+  int codec;              // RtdAudioCodec, see "setAudioOutput"
+  int extradata_len;      // actual bytes used in extradata
+  unsigned char extradata[RTD_AUDIO_EXTRADATA_LEN];
+} RtdAudioCodecInfo;
+
+typedef enum RtdAudioOutput {
+  RTD_AUDIO_OUTPUT_PCM = 0,       // decode audio inside rtd (default)
+  RTD_AUDIO_OUTPUT_ENCODED,       // deliver encoded frames as received
+} RtdAudioOutput;
+
+// use command(..., "setAudioOutput", RtdAudioOutputConf*) before open
+typedef struct RtdAudioOutputConf {
+  int output;             // RtdAudioOutput
+} RtdAudioOutputConf;
+
+typedef enum RtdThreadMode {
+  RTD_THREAD_OWN_SIGNALING = 0,   // network and worker threads shared by all
+                                  // streams, a signaling thread per stream
+                                  // (default)
+  RTD_THREAD_SHARED_SIGNALING,    // signaling also on the shared worker thread
+} RtdThreadMode;
+
+// use command(..., "setThreadMode", RtdThreadConf*) before open
+typedef struct RtdThreadConf {
+  int mode;               // RtdThreadMode
+} RtdThreadConf;
+
+// settings of the streams prepare() makes connections for, see RtdApiFuncs
+typedef struct RtdPrepareConf {
+  int audio_output;       // RtdAudioOutput, as set by "setAudioOutput"
+  int thread_mode;        // RtdThreadMode, as set by "setThreadMode"
+} RtdPrepareConf;
+
+// media argument of read_media
+typedef enum RtdReadMedia {
+  RTD_READ_MEDIA_AUDIO = 0,
+  RTD_READ_MEDIA_VIDEO,
+} RtdReadMedia;
+
+typedef enum RtdReadMode {
+  RTD_READ_VIDEO_FIRST = 0,   // drain queued video before audio (default)
+  RTD_READ_INTERLEAVED,       // earliest dts across audio and video first
+} RtdReadMode;
+
+// use command(..., "setReadMode", RtdReadConf*) to set
+typedef struct RtdReadConf {
+  int mode;               // RtdReadMode
+  int max_skew_ms;        // RTD_READ_INTERLEAVED only: when just one media is
+                          // queued and it is more than this ahead (in dts) of
+                          // the other, wait up to this long for the other
+} RtdReadConf;
+
+// use command(..., "setAudioPacketDuration", RtdAudioPacketConf*) before open
+typedef struct RtdAudioPacketConf {
+  int duration_ms;        // pcm per audio frame, e.g. 20, 40 or the audio
+                          // device period. Consecutive 10ms frames are
+                          // merged up to this duration; 0 or 10: no merging
+} RtdAudioPacketConf;
+
+// use command(..., "setLatencyControl", RtdLatencyConf*) to set
+typedef struct RtdLatencyConf {
+  int max_buffer_ms;      // when more than this many ms of media (by pts) is
+                          // queued, the oldest frames are dropped: video up
+                          // to a key frame, audio up to the same pts. 0: off
+} RtdLatencyConf;
+
+// use command(..., "getStartupMetrics", RtdStartupMetrics*) to fetch
+// Each phase in ms since open (or the last "switch"), -1 until reached, 0 if
+// done ahead by prepare().
+typedef struct RtdStartupMetrics {
+  int threads_started_ms;
+  int factory_created_ms;
+  int offer_created_ms;
+  int signaling_sent_ms;
+  int answer_received_ms;
+  int http_dns_ms;              // of the signaling request, ms since it was
+  int http_connect_ms;          // sent as reported by curl; connect and tls
+  int http_tls_ms;              // are 0 on a reused connection, tls also for
+  int http_first_byte_ms;       // plain http
+  int remote_description_set_ms;
+  int ice_connected_ms;
+  int first_audio_packet_ms;    // first rtp packet
+  int first_video_packet_ms;
+  int first_key_frame_ms;       // first complete key frame out of the jitter buffer
+  int first_audio_frame_ms;     // first frame into the queue
+  int first_video_frame_ms;
+  int first_audio_read_ms;      // first frame read by the player
+  int first_video_read_ms;
+} RtdStartupMetrics;
+
+// use command(..., "getStats", RtdStats*) to poll, cheap enough for once a
+// second. Counters are totals since open; fields of a media not received yet
+// are -1. The rtp and jitter buffer fields are refreshed once a second.
+typedef struct RtdStats {
+  // audio, rtp and NetEq
+  int audio_packets_received;
+  int audio_packets_lost;
+  int audio_jitter_ms;          // interarrival jitter
+  int audio_nacks_sent;
+  int audio_buffer_ms;          // NetEq buffer now
+  int audio_target_buffer_ms;   // and where NetEq steers it
+  float audio_expand_rate;      // fractions of the output, 0..1: concealment,
+  float audio_accelerate_rate;  // time compressed and time stretched
+  float audio_preemptive_rate;
+  // video, rtp and the jitter buffer
+  int video_packets_received;
+  int video_packets_lost;
+  int video_jitter_ms;          // interarrival jitter
+  int video_nacks_sent;
+  int video_rtx_received;       // retransmissions that arrived
+  int video_buffered_frames;    // in the jitter buffer
+  int video_jitter_buffer_ms;   // jitter estimate
+  // rtd queues, read by the player
+  int audio_queue_frames;
+  int audio_queue_ms;
+  int video_queue_frames;
+  int video_queue_ms;
+  int audio_dropped_frames;     // dropped or discarded before being read
+  int video_dropped_frames;
+  // AAC decode, -1 for other codecs and in passthrough
+  int audio_decoded_frames;
+  int audio_decoded_ahead;      // of those, as they arrived, off the playout tick
+  int audio_decode_avg_us;      // time per decode
+  int audio_decode_max_us;
+  int audio_decode_late;        // deadline misses: playout waited for or ran the decode
+} RtdStats;
+
 typedef struct RtdFrame {
   void* buf;              // where frame data is stored
   int size;               // size of frame data in bytes
   int is_audio;           // 1 for audio frame, 0 for video frame
   uint64_t pts;           // presentation time stamp, in ms
   uint64_t dts;           // decoding time stamp, in ms
-  int flag;               // for video frame (is_audio == 0)
-                          // bit 0: key frame;
+  int flag;               // bit 0: key frame, video only;
+                          // bit 1: first frame after "switch", audio and
+                          //        video; what came before is unrelated
   int duration;           // in ms
+  void* opaque;           // owned by rtd, do not modify
 } RtdFrame;
 
 typedef struct RtdAudioDecodedInfo {
-  uint8_t* encoded_data;
+  const uint8_t* encoded_data;  // in the packet, valid during the call only
   int encoded_size;
   int dst_sample_rate;
   int dst_channels;
+  int dst_capacity;   // samples across all channels |decoded| can take
 } RtdAudioDecodedInfo;
 
 typedef struct RtdAudioDecoderInitParam {
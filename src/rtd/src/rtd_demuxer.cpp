@@ -1,4 +1,5 @@
 #include "rtd_demuxer.h"
+#include <algorithm>
 #include "rtd_frame_queue.h"
 #include "rtd_api.h"
 #include "rtc_base/logging.h"
@@ -7,11 +8,33 @@
 namespace {
 
 constexpr int kRtdAudioFrameLen = 960;        // 48000*0.01*2  10ms
-constexpr int kRtdVideoFrameLen = 1382400;    // 1280*720*3/2  1 frame
+constexpr int kRtdVideoFrameLen = 4096;       // smallest video buffer class, grows by 2x
 constexpr int kRtdAudioBufCapacity = 800;     // about 5000ms
 constexpr int kRtdVideoBufCapacity = 120;     // about 5000ms
 constexpr int kRtdLogPrintInterval = 5000;    // 5000ms print once
 constexpr int kAudioFrameDuration = 10;       // 10ms per audio frame
+constexpr int kRtdMaxAudioPacketMs = 200;     // "setAudioPacketDuration" limit
+constexpr int kRtdDefaultMaxSkewMs = 100;     // interleaved read
+constexpr int kRtdReadAnyMedia = -1;          // ReadFrameTimed() on both queues
+constexpr size_t kRtdFreeBatchSize = 64;      // frames per RtdFrameQueue::FreeBuffers()
+constexpr size_t kRtdVideoDropCount = kRtdVideoBufCapacity / 4;  // frames freed on overflow
+
+// True if the first VCL NAL unit of an Annex B H.264 access unit has
+// nal_ref_idc 0, i.e. no other picture is predicted from this one.
+bool IsDisposableH264Frame(const uint8_t* data, size_t size) {
+  for (size_t i = 0; i + 3 < size; ++i) {
+    if (data[i] != 0 || data[i + 1] != 0 || data[i + 2] != 1) {
+      continue;
+    }
+    uint8_t header = data[i + 3];
+    int nal_type = header & 0x1f;
+    if (nal_type >= 1 && nal_type <= 5) {
+      return (header & 0x60) == 0;
+    }
+    i += 3;
+  }
+  return false;
+}
 
 } // namespace
 
@@ -20,17 +43,45 @@ namespace rtd {
 
 RtdDemuxer::RtdDemuxer(RtdConf conf)
     : conf_(conf),
-      video_queue_(new RtdFrameQueue(kRtdVideoBufCapacity, kRtdVideoFrameLen)),
-      audio_queue_(new RtdFrameQueue(kRtdAudioBufCapacity, kRtdAudioFrameLen)),
-      frame_(new RtdFrame()),
-      current_frame_buffer_(nullptr),
+      video_queue_(RtdFrameQueue::Create(kRtdVideoBufCapacity, kRtdVideoFrameLen)),
+      audio_queue_(RtdFrameQueue::Create(kRtdAudioBufCapacity, kRtdAudioFrameLen)),
       last_audio_receive_failed_(false),
+      audio_output_(RTD_AUDIO_OUTPUT_PCM),
+      thread_mode_(RTD_THREAD_OWN_SIGNALING),
+      audio_packet_ms_(kAudioFrameDuration),
+      pending_audio_pts_(0),
+      pending_audio_end_rtp_(0),
+      pending_audio_samples_(0),
+      pending_audio_sample_rate_(0),
+      pending_audio_channels_(0),
+      last_encoded_audio_rtp_(-1),
       last_video_receive_failed_(false),
       iframe_requested_(false),
       audio_log_print_last_(0),
       video_log_print_last_(0),
       read_audio_frame_last_(0),
-      read_video_frame_last_(0) {
+      read_video_frame_last_(0),
+      read_mode_(RTD_READ_VIDEO_FIRST),
+      max_skew_ms_(kRtdDefaultMaxSkewMs),
+      audio_read_(false),
+      video_read_(false),
+      last_audio_dts_(0),
+      last_video_dts_(0),
+      skew_wait_start_ms_(0),
+      max_buffer_ms_(0),
+      pending_audio_trim_pts_(-1),
+      audio_switched_(false),
+      video_switched_(false),
+      audio_discontinuity_(false),
+      video_discontinuity_(false),
+      open_time_ms_(0),
+      first_audio_read_ms_(-1),
+      first_video_read_ms_(-1),
+      audio_queue_ms_(0),
+      video_queue_ms_(0),
+      audio_discarded_(0),
+      video_discarded_(0),
+      closed_(false) {
   RTC_LOG(LS_INFO) << "RtdDemuxer::RtdDemuxer().";
 }
 
@@ -40,10 +91,18 @@ RtdDemuxer::~RtdDemuxer() {
 
 int RtdDemuxer::Open(const std::string& url, const char* mode) {
   RTC_LOG(LS_INFO) << "RtdDemuxer::Open()";
-  rtd_engine_ = RtdEngineInterface::Create(this, url, conf_);
-  if (nullptr == rtd_engine_) {
-    RTC_LOG(LS_ERROR) << "Failed to create Rtd Engine.";
-    return RTD_ERROR_NULL_IS_PTR;
+  open_time_ms_ = rtc::TimeMillis();
+  rtd_engine_ = RtdEngineInterface::CreatePrepared(this, url, conf_, audio_output_, thread_mode_);
+  if (rtd_engine_) {
+    RTC_LOG(LS_INFO) << "RtdDemuxer::Open() using a prepared engine.";
+  } else {
+    rtd_engine_ = RtdEngineInterface::Create(this, url, conf_);
+    if (nullptr == rtd_engine_) {
+      RTC_LOG(LS_ERROR) << "Failed to create Rtd Engine.";
+      return RTD_ERROR_NULL_IS_PTR;
+    }
+    rtd_engine_->SetAudioOutput(audio_output_);
+    rtd_engine_->SetThreadMode(thread_mode_);
   }
 
   int ret = rtd_engine_->Open();
@@ -55,50 +114,179 @@ int RtdDemuxer::Open(const std::string& url, const char* mode) {
 }
 
 int RtdDemuxer::ReadFrame(RtdFrame*& frame) {
-  // try to read video frame
-  if (video_queue_ && video_queue_->ReadFront(current_frame_buffer_)) {
+  if (read_mode_ == RTD_READ_INTERLEAVED) {
+    return ReadFrameInterleaved(frame);
+  }
+
+  // try to read video frame, then audio frame
+  if (ReadVideoFrame(frame) == 0) {
+    return 0;
+  }
+  return ReadAudioFrame(frame);
+}
+
+int RtdDemuxer::ReadFrameInterleaved(RtdFrame*& frame) {
+  uint64_t video_dts = 0;
+  uint64_t audio_dts = 0;
+  bool has_video = video_queue_ && video_queue_->PeekFront(video_dts);
+  bool has_audio = audio_queue_ && audio_queue_->PeekFront(audio_dts);
+  if (!has_video && !has_audio) {
+    return 1;   // continue reading
+  }
+
+  if (has_video && has_audio) {
+    skew_wait_start_ms_ = 0;
+    return video_dts < audio_dts ? ReadVideoFrame(frame) : ReadAudioFrame(frame);
+  }
+
+  // Only one media is queued. If it is well ahead of what the other one has
+  // delivered, the other is likely just late: give it up to |max_skew_ms_|.
+  bool other_read = has_video ? audio_read_ : video_read_;
+  uint64_t dts = has_video ? video_dts : audio_dts;
+  uint64_t other_dts = has_video ? last_audio_dts_ : last_video_dts_;
+  if (other_read && dts > other_dts + max_skew_ms_) {
     int64_t now_ms = rtc::TimeMillis();
-    if (now_ms - read_video_frame_last_ > kRtdLogPrintInterval) {
-      RTC_LOG(LS_INFO) << "RtdDemuxer::ReadFrame: Read video frame, pts:" << current_frame_buffer_->pts << " type:" << current_frame_buffer_->flag;
-      read_video_frame_last_ = now_ms;
-    }
-    if (frame_) {
-      frame_->buf = current_frame_buffer_->buffer->data();
-      frame_->size = (int)current_frame_buffer_->buffer->size();
-      frame_->duration = current_frame_buffer_->duration;
-      frame_->dts = current_frame_buffer_->dts;
-      frame_->pts = current_frame_buffer_->pts;
-      frame_->flag = current_frame_buffer_->flag;
-      frame_->is_audio = 0;
-      frame = frame_.get();
-      return 0;
-    } else {
+    if (skew_wait_start_ms_ == 0) {
+      skew_wait_start_ms_ = now_ms;
+    }
+    if (now_ms - skew_wait_start_ms_ < max_skew_ms_) {
       return 1;
     }
-  } else {
-    // try to read audio frame
-    if (audio_queue_ && audio_queue_->ReadFront(current_frame_buffer_)) {
-      int64_t now_ms = rtc::TimeMillis();
-      if (now_ms - read_audio_frame_last_ > kRtdLogPrintInterval) {
-        RTC_LOG(LS_INFO) << "RtdDemuxer::ReadFrame: Read audio frame, pts:" << current_frame_buffer_->pts;
-        read_audio_frame_last_ = now_ms;
-      }
-      if (frame_) {
-        frame_->buf = current_frame_buffer_->buffer->data();
-        frame_->size = (int)current_frame_buffer_->buffer->size();
-        frame_->duration = current_frame_buffer_->duration;
-        frame_->dts = current_frame_buffer_->dts;
-        frame_->pts = current_frame_buffer_->pts;
-        frame_->is_audio = 1;
-        frame = frame_.get();
-        return 0;
-      } else {
-        return 1;
+  }
+
+  skew_wait_start_ms_ = 0;
+  return has_video ? ReadVideoFrame(frame) : ReadAudioFrame(frame);
+}
+
+int RtdDemuxer::ReadVideoFrame(RtdFrame*& frame) {
+  RtdFrameBuffer* buffer = nullptr;
+  if (!video_queue_ || !video_queue_->ReadFront(buffer)) {
+    return 1;
+  }
+
+  int64_t now_ms = rtc::TimeMillis();
+  if (now_ms - read_video_frame_last_ > kRtdLogPrintInterval) {
+    RTC_LOG(LS_INFO) << "RtdDemuxer::ReadFrame: Read video frame, pts:" << buffer->pts << " type:" << buffer->flag;
+    read_video_frame_last_ = now_ms;
+  }
+  if (first_video_read_ms_ < 0) {
+    first_video_read_ms_ = static_cast<int>(now_ms - open_time_ms_);
+  }
+  video_read_ = true;
+  last_video_dts_ = buffer->dts;
+  frame = ExportFrame(buffer, 0);
+  return 0;
+}
+
+int RtdDemuxer::ReadAudioFrame(RtdFrame*& frame) {
+  RtdFrameBuffer* buffer = nullptr;
+  if (!audio_queue_ || !audio_queue_->ReadFront(buffer)) {
+    return 1;
+  }
+
+  int64_t now_ms = rtc::TimeMillis();
+  if (now_ms - read_audio_frame_last_ > kRtdLogPrintInterval) {
+    RTC_LOG(LS_INFO) << "RtdDemuxer::ReadFrame: Read audio frame, pts:" << buffer->pts;
+    read_audio_frame_last_ = now_ms;
+  }
+  if (first_audio_read_ms_ < 0) {
+    first_audio_read_ms_ = static_cast<int>(now_ms - open_time_ms_);
+  }
+  audio_read_ = true;
+  last_audio_dts_ = buffer->dts;
+  frame = ExportFrame(buffer, 1);
+  return 0;
+}
+
+int RtdDemuxer::ReadFrames(RtdFrame** frames, int max_count, int* count) {
+  int n = 0;
+  while (n < max_count && ReadFrame(frames[n]) == 0) {
+    ++n;
+  }
+  *count = n;
+  return n > 0 ? 0 : 1;
+}
+
+RtdFrame* RtdDemuxer::ExportFrame(RtdFrameBuffer* buffer, int is_audio) {
+  RtdFrame* frame = &buffer->frame;
+  frame->buf = buffer->buffer->data();
+  frame->size = (int)buffer->size;
+  frame->duration = buffer->duration;
+  frame->dts = buffer->dts;
+  frame->pts = buffer->pts;
+  frame->flag = buffer->flag & (is_audio ? kRtdFrameDiscontinuity : (kRtdFrameKey | kRtdFrameDiscontinuity));
+  frame->is_audio = is_audio;
+  return frame;
+}
+
+int RtdDemuxer::ReadFrame(RtdFrame*& frame, int timeout_ms) {
+  return ReadFrameTimed(kRtdReadAnyMedia, frame, timeout_ms);
+}
+
+int RtdDemuxer::ReadMediaFrame(int media, RtdFrame*& frame, int timeout_ms) {
+  if (media != RTD_READ_MEDIA_AUDIO && media != RTD_READ_MEDIA_VIDEO) {
+    RTC_LOG(LS_ERROR) << "RtdDemuxer::ReadMediaFrame invalid media:" << media;
+    return -1;
+  }
+  return ReadFrameTimed(media, frame, timeout_ms);
+}
+
+int RtdDemuxer::ReadFrameTimed(int media, RtdFrame*& frame, int timeout_ms) {
+  RtdFrameWaiter& waiter = media == RTD_READ_MEDIA_AUDIO ? audio_waiter_ :
+                           media == RTD_READ_MEDIA_VIDEO ? video_waiter_ : any_waiter_;
+  int64_t deadline_ms = rtc::TimeMillis() + timeout_ms;
+  while (true) {
+    int ret = media == RTD_READ_MEDIA_AUDIO ? ReadAudioFrame(frame) :
+              media == RTD_READ_MEDIA_VIDEO ? ReadVideoFrame(frame) : ReadFrame(frame);
+    if (ret != 1 || closed_) {
+      return ret;
+    }
+
+    int64_t now_ms = rtc::TimeMillis();
+    int64_t remaining_ms = deadline_ms - now_ms;
+    if (remaining_ms <= 0) {
+      return ret;
+    }
+
+    // A frame held back by the interleave gate is queued already: wait for
+    // the other media or the end of the skew wait instead of spinning.
+    int64_t skew_wait_ms = media == kRtdReadAnyMedia ? SkewWaitMs(now_ms) : 0;
+
+    // Register as waiter before re-checking the queues, the producer checks
+    // |waiting| after queueing, so one of the two sees the other.
+    waiter.waiting.fetch_add(1);
+    if (skew_wait_ms > 0) {
+      if (!(HasQueuedFrame(RTD_READ_MEDIA_AUDIO) && HasQueuedFrame(RTD_READ_MEDIA_VIDEO)) && !closed_) {
+        waiter.event.Wait(static_cast<int>(std::min(remaining_ms, skew_wait_ms)));
       }
+    } else if (!HasQueuedFrame(media) && !closed_) {
+      waiter.event.Wait(static_cast<int>(remaining_ms));
     }
+    waiter.waiting.fetch_sub(1);
+  }
+}
+
+bool RtdDemuxer::HasQueuedFrame(int media) {
+  bool has_audio = media != RTD_READ_MEDIA_VIDEO && audio_queue_->Size() > 0;
+  bool has_video = media != RTD_READ_MEDIA_AUDIO && video_queue_->Size() > 0;
+  return has_audio || has_video;
+}
+
+int64_t RtdDemuxer::SkewWaitMs(int64_t now_ms) const {
+  if (read_mode_ != RTD_READ_INTERLEAVED || skew_wait_start_ms_ == 0) {
+    return 0;
+  }
+  return std::max<int64_t>(max_skew_ms_ - (now_ms - skew_wait_start_ms_), 0);
+}
+
+void RtdDemuxer::NotifyFrameAvailable(RtdFrameWaiter& waiter) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiter.waiting.load(std::memory_order_relaxed) > 0) {
+    waiter.event.Set();
+  }
+  if (any_waiter_.waiting.load(std::memory_order_relaxed) > 0) {
+    any_waiter_.event.Set();
   }
-  
-  return 1;   // continue reading
 }
 
 int RtdDemuxer::Command(const char* cmd, void* arg) {
@@ -113,13 +301,141 @@ int RtdDemuxer::Command(const char* cmd, void* arg) {
     }
 
     return -1;
+  } else if (strcmp(cmd, "getAudioCodecInfo") == 0) {
+    if (!arg || !rtd_engine_) {
+      return -1;
+    }
+    return rtd_engine_->GetAudioCodecInfo(*static_cast<RtdAudioCodecInfo*>(arg));
+  } else if (strcmp(cmd, "setReadMode") == 0) {
+    RtdReadConf* read_conf = static_cast<RtdReadConf*>(arg);
+    if (!read_conf || read_conf->max_skew_ms < 0) {
+      return -1;
+    }
+    RTC_LOG(LS_INFO) << "RtdDemuxer::Command setReadMode mode:" << read_conf->mode
+                     << " max_skew_ms:" << read_conf->max_skew_ms;
+    read_mode_ = read_conf->mode == RTD_READ_INTERLEAVED ? RTD_READ_INTERLEAVED : RTD_READ_VIDEO_FIRST;
+    max_skew_ms_ = read_conf->max_skew_ms;
+    skew_wait_start_ms_ = 0;
+    return 0;
+  } else if (strcmp(cmd, "setAudioPacketDuration") == 0) {
+    RtdAudioPacketConf* packet_conf = static_cast<RtdAudioPacketConf*>(arg);
+    if (!packet_conf || packet_conf->duration_ms < 0 || packet_conf->duration_ms > kRtdMaxAudioPacketMs ||
+        rtd_engine_) {   // only before Open(), the queue is sized for it
+      return -1;
+    }
+    int duration_ms = std::max(packet_conf->duration_ms, kAudioFrameDuration);
+    RTC_LOG(LS_INFO) << "RtdDemuxer::Command setAudioPacketDuration duration_ms:" << duration_ms;
+    // Nothing is queued yet, size the queue for the same time span.
+    int capacity = std::max(kRtdAudioBufCapacity * kAudioFrameDuration / duration_ms, 1);
+    audio_queue_ = RtdFrameQueue::Create(capacity, kRtdAudioFrameLen * duration_ms / kAudioFrameDuration);
+    audio_packet_ms_ = duration_ms;
+    return 0;
+  } else if (strcmp(cmd, "setLatencyControl") == 0) {
+    RtdLatencyConf* latency_conf = static_cast<RtdLatencyConf*>(arg);
+    if (!latency_conf || latency_conf->max_buffer_ms < 0) {
+      return -1;
+    }
+    RTC_LOG(LS_INFO) << "RtdDemuxer::Command setLatencyControl max_buffer_ms:" << latency_conf->max_buffer_ms;
+    max_buffer_ms_ = latency_conf->max_buffer_ms;
+    return 0;
+  } else if (strcmp(cmd, "setAudioOutput") == 0) {
+    RtdAudioOutputConf* output_conf = static_cast<RtdAudioOutputConf*>(arg);
+    if (!output_conf || rtd_engine_) {   // only before Open()
+      return -1;
+    }
+    RTC_LOG(LS_INFO) << "RtdDemuxer::Command setAudioOutput output:" << output_conf->output;
+    audio_output_ = output_conf->output == RTD_AUDIO_OUTPUT_ENCODED ? RTD_AUDIO_OUTPUT_ENCODED : RTD_AUDIO_OUTPUT_PCM;
+    return 0;
+  } else if (strcmp(cmd, "setThreadMode") == 0) {
+    RtdThreadConf* thread_conf = static_cast<RtdThreadConf*>(arg);
+    if (!thread_conf || rtd_engine_) {   // only before Open()
+      return -1;
+    }
+    RTC_LOG(LS_INFO) << "RtdDemuxer::Command setThreadMode mode:" << thread_conf->mode;
+    thread_mode_ = thread_conf->mode == RTD_THREAD_SHARED_SIGNALING ? RTD_THREAD_SHARED_SIGNALING : RTD_THREAD_OWN_SIGNALING;
+    return 0;
+  } else if (strcmp(cmd, "switch") == 0) {
+    const char* url = static_cast<const char*>(arg);
+    if (!url || !rtd_engine_) {
+      return -1;
+    }
+    RTC_LOG(LS_INFO) << "RtdDemuxer::Command switch url:" << url;
+    return Switch(url);
+  } else if (strcmp(cmd, "getStartupMetrics") == 0) {
+    RtdStartupMetrics* metrics = static_cast<RtdStartupMetrics*>(arg);
+    if (!metrics || !rtd_engine_) {
+      return -1;
+    }
+    rtd_engine_->GetStartupMetrics(*metrics);
+    metrics->first_audio_read_ms = first_audio_read_ms_;
+    metrics->first_video_read_ms = first_video_read_ms_;
+    return 0;
+  } else if (strcmp(cmd, "getStats") == 0) {
+    RtdStats* stats = static_cast<RtdStats*>(arg);
+    if (!stats || !rtd_engine_ || rtd_engine_->GetStats(*stats) != 0) {
+      return -1;
+    }
+    stats->audio_queue_frames = static_cast<int>(audio_queue_->Size());
+    stats->audio_queue_ms = audio_queue_ms_;
+    stats->video_queue_frames = static_cast<int>(video_queue_->Size());
+    stats->video_queue_ms = video_queue_ms_;
+    stats->audio_dropped_frames = static_cast<int>(audio_queue_->DroppedFrames() + audio_discarded_);
+    stats->video_dropped_frames = static_cast<int>(video_queue_->DroppedFrames() + video_discarded_);
+    return 0;
+  } else if (strcmp(cmd, "requestKeyFrame") == 0) {   // e.g. after a decoder error
+    if (!rtd_engine_) {
+      return -1;
+    }
+    RTC_LOG(LS_INFO) << "RtdDemuxer::Command requestKeyFrame";
+    rtd_engine_->RequestKeyFrame();
+    return 0;
   }
 
   return -1;
 }
 
+int RtdDemuxer::Switch(const std::string& url) {
+  // The engine stops delivering the old stream first; the producers then
+  // start over at the first frame of the new one.
+  if (rtd_engine_->Switch(url) != 0) {
+    RTC_LOG(LS_ERROR) << "RtdDemuxer::Switch() failed.";
+    return -1;
+  }
+  open_time_ms_ = rtc::TimeMillis();
+  first_audio_read_ms_ = -1;
+  first_video_read_ms_ = -1;
+  audio_switched_ = true;
+  video_switched_ = true;
+  return 0;
+}
+
+void RtdDemuxer::StartAudioAfterSwitch() {
+  if (!audio_switched_.exchange(false)) {
+    return;
+  }
+  pending_audio_.Clear();
+  pending_audio_samples_ = 0;
+  last_encoded_audio_rtp_ = -1;
+  pending_audio_trim_pts_ = -1;
+  audio_queue_->Clear();
+  audio_discontinuity_ = true;
+}
+
+void RtdDemuxer::StartVideoAfterSwitch() {
+  if (!video_switched_.exchange(false)) {
+    return;
+  }
+  video_queue_->Clear();
+  iframe_requested_ = true;   // the new stream starts at a key frame
+  video_discontinuity_ = true;
+}
+
 int RtdDemuxer::Close() {
   RTC_LOG(LS_INFO) << "RtdDemuxer::Close().";
+  closed_ = true;
+  any_waiter_.event.Set();
+  audio_waiter_.event.Set();
+  video_waiter_.event.Set();
   if (rtd_engine_) {
     rtd_engine_->Close();
     rtd_engine_.reset(nullptr);
@@ -128,18 +444,35 @@ int RtdDemuxer::Close() {
 }
 
 void RtdDemuxer::FreeFrame(RtdFrame* frame) {
-  if (frame && current_frame_buffer_) {
-    if (frame->is_audio) {
-      audio_queue_->FreeBuffer(current_frame_buffer_);
+  FreeFrames(&frame, 1);
+}
+
+void RtdDemuxer::FreeFrames(RtdFrame* const* frames, int count) {
+  // Hand runs of frames from the same queue over in one call.
+  RtdFrameBuffer* buffers[kRtdFreeBatchSize];
+  int i = 0;
+  while (i < count) {
+    RtdFrameQueue* queue = nullptr;
+    size_t n = 0;
+    for (; i < count && n < kRtdFreeBatchSize; ++i) {
+      if (!frames[i] || !frames[i]->opaque) {
+        continue;
+      }
+      RtdFrameBuffer* buffer = static_cast<RtdFrameBuffer*>(frames[i]->opaque);
+      if (queue && buffer->queue != queue) {
+        break;
+      }
+      queue = buffer->queue;
+      buffers[n++] = buffer;
     }
-    else {
-      video_queue_->FreeBuffer(current_frame_buffer_);
+    if (n > 0) {
+      queue->FreeBuffers(buffers, n);
     }
-    current_frame_buffer_ = nullptr;
   }
 }
 
 void RtdDemuxer::OnAudioFrame(const RtdAudioFrame& frame) {
+  StartAudioAfterSwitch();
   int64_t now_ms = rtc::TimeMillis();
   if (now_ms - audio_log_print_last_ > kRtdLogPrintInterval) {
     RTC_LOG(LS_INFO) << "Insert audio timestamp_ms:" << frame.timestamp_ms << " timestamp_rtp:" << frame.timestamp_rtp 
@@ -147,9 +480,51 @@ void RtdDemuxer::OnAudioFrame(const RtdAudioFrame& frame) {
     audio_log_print_last_ = now_ms;
   }
 
-  // 10ms pcm
+  int packet_ms = audio_packet_ms_.load(std::memory_order_relaxed);
   int size = frame.samples_per_channel * frame.num_channels * sizeof(int16_t);
-  if (!audio_queue_->WriteBack(frame.data, size, frame.timestamp_ms, frame.timestamp_ms, kAudioFrameDuration)) {
+  if (packet_ms <= kAudioFrameDuration) {
+    // 10ms pcm
+    FlushPendingAudio();
+    WriteAudioFrame(frame.data, size, frame.timestamp_ms, kAudioFrameDuration);
+    return;
+  }
+
+  // Merge consecutive frames of the same format, start over on a gap.
+  if (pending_audio_samples_ > 0 &&
+      (frame.timestamp_rtp != pending_audio_end_rtp_ ||
+       frame.sample_rate_hz != pending_audio_sample_rate_ ||
+       frame.num_channels != pending_audio_channels_)) {
+    FlushPendingAudio();
+  }
+  if (pending_audio_samples_ == 0) {
+    pending_audio_pts_ = frame.timestamp_ms;
+    pending_audio_sample_rate_ = frame.sample_rate_hz;
+    pending_audio_channels_ = frame.num_channels;
+  }
+  pending_audio_.AppendData(reinterpret_cast<const uint8_t*>(frame.data), size);
+  pending_audio_samples_ += frame.samples_per_channel;
+  pending_audio_end_rtp_ = frame.timestamp_rtp + frame.samples_per_channel;
+
+  if (pending_audio_samples_ * 1000 >= static_cast<size_t>(packet_ms) * pending_audio_sample_rate_) {
+    FlushPendingAudio();
+  }
+}
+
+void RtdDemuxer::FlushPendingAudio() {
+  if (pending_audio_samples_ == 0) {
+    return;
+  }
+  int duration = static_cast<int>(pending_audio_samples_ * 1000 / pending_audio_sample_rate_);
+  WriteAudioFrame(pending_audio_.data(), pending_audio_.size(), pending_audio_pts_, duration);
+  pending_audio_.Clear();
+  pending_audio_samples_ = 0;
+}
+
+void RtdDemuxer::WriteAudioFrame(const void* data, size_t size, int64_t pts, int duration) {
+  TrimAudioQueue();
+  int flag = audio_discontinuity_ ? kRtdFrameDiscontinuity : 0;
+  if (!audio_queue_->WriteBack(data, size, pts, pts, duration, flag)) {
+    audio_discarded_.fetch_add(1, std::memory_order_relaxed);
     if (last_audio_receive_failed_) {   // reduce duplicated failing process
       return;
     }
@@ -159,15 +534,102 @@ void RtdDemuxer::OnAudioFrame(const RtdAudioFrame& frame) {
     if (last_audio_receive_failed_) {
       last_audio_receive_failed_ = false;
     }
+    audio_discontinuity_ = false;
+    audio_queue_ms_ = static_cast<int>(audio_queue_->BufferedMs());
+    NotifyFrameAvailable(audio_waiter_);
+  }
+}
+
+void RtdDemuxer::TrimAudioQueue() {
+  int64_t trim_pts = pending_audio_trim_pts_.exchange(-1);
+  if (trim_pts >= 0) {
+    audio_queue_->DropBefore(static_cast<uint64_t>(trim_pts));
+  }
+  int max_buffer_ms = max_buffer_ms_.load(std::memory_order_relaxed);
+  if (max_buffer_ms > 0) {
+    int64_t trim_ms = audio_queue_->BufferedMs() - max_buffer_ms;
+    if (trim_ms > 0) {
+      audio_queue_->DropOldest(trim_ms, false);
+    }
+  }
+}
+
+void RtdDemuxer::TrimVideoQueue(int64_t newest_pts) {
+  int max_buffer_ms = max_buffer_ms_.load(std::memory_order_relaxed);
+  if (max_buffer_ms <= 0) {
+    return;
+  }
+  int64_t buffered_ms = video_queue_->BufferedMs();
+  if (buffered_ms <= max_buffer_ms) {
+    return;
+  }
+
+  int64_t dropped_ms = video_queue_->DropOldest(buffered_ms - max_buffer_ms, true);
+  if (dropped_ms < 0) {
+    // No key frame to restart from, start over at the next one.
+    dropped_ms = buffered_ms;
+    RequestKeyFrame();
+  }
+  RTC_LOG(LS_WARNING) << "RtdDemuxer::TrimVideoQueue buffered_ms:" << buffered_ms
+                      << " dropped_ms:" << dropped_ms << " max_buffer_ms:" << max_buffer_ms;
+  // Audio and video pts share the media clock's timeline, the audio goes up
+  // to the first video frame kept.
+  int64_t cut_pts = newest_pts - buffered_ms + dropped_ms;
+  int64_t pending_pts = pending_audio_trim_pts_.load();
+  while (cut_pts > pending_pts && !pending_audio_trim_pts_.compare_exchange_weak(pending_pts, cut_pts)) {
+  }
+}
+
+void RtdDemuxer::OnEncodedAudioFrame(const RtdEncodedAudioFrame& frame) {
+  StartAudioAfterSwitch();
+  // Frames arrive as received, before NetEq reorders them. Keep dts
+  // increasing, a late frame would only be dropped by the decoder anyway.
+  if (frame.timestamp_rtp <= last_encoded_audio_rtp_) {
+    return;
+  }
+  last_encoded_audio_rtp_ = frame.timestamp_rtp;
+
+  int64_t now_ms = rtc::TimeMillis();
+  if (now_ms - audio_log_print_last_ > kRtdLogPrintInterval) {
+    RTC_LOG(LS_INFO) << "Insert encoded audio timestamp_ms:" << frame.timestamp_ms << " timestamp_rtp:" << frame.timestamp_rtp
+                     << " size:" << frame.size;
+    audio_log_print_last_ = now_ms;
+  }
+
+  WriteAudioFrame(frame.data, frame.size, frame.timestamp_ms, frame.duration_ms);
+}
+
+void RtdDemuxer::RequestKeyFrame() {
+  iframe_requested_ = true;
+  if (rtd_engine_) {
+    rtd_engine_->RequestKeyFrame();
   }
 }
 
+bool RtdDemuxer::MakeVideoRoom() {
+  size_t disposable = video_queue_->DropDisposable(kRtdVideoDropCount);
+  size_t gop_tail = 0;
+  if (disposable < kRtdVideoDropCount) {
+    gop_tail = video_queue_->DropGopTails(kRtdVideoDropCount - disposable);
+  }
+  if (disposable + gop_tail == 0) {
+    return false;
+  }
+
+  RTC_LOG(LS_WARNING) << "RtdDemuxer::MakeVideoRoom() video queue full, dropped non-reference frames:"
+                      << disposable << " gop tail frames:" << gop_tail;
+  return true;
+}
+
 void RtdDemuxer::OnVideoFrame(const RtdVideoFrame& frame) {
-  int flag = (frame.frame_type == RtdFrameType::RTD_KEY_FRAME) ? 1 : 0;
+  StartVideoAfterSwitch();
+  int flag = (frame.frame_type == RtdFrameType::RTD_KEY_FRAME) ? kRtdFrameKey : 0;
   int64_t now_ms = rtc::TimeMillis();
   if (now_ms - video_log_print_last_ > kRtdLogPrintInterval) {
     RTC_LOG(LS_INFO) << "Insert video timestamp_ms:" << frame.timestamp_ms << " play_timestamp_ms:" 
-                     << frame.play_timestamp_ms << " timestamp_rtp:" << frame.timestamp_rtp << " type:" << flag;
+                     << frame.play_timestamp_ms << " timestamp_rtp:" << frame.timestamp_rtp << " type:" << flag
+                     << " video_queue_bytes:" << video_queue_->AllocatedBytes()
+                     << " audio_queue_bytes:" << audio_queue_->AllocatedBytes();
     video_log_print_last_ = now_ms;
   }
 
@@ -177,23 +639,42 @@ void RtdDemuxer::OnVideoFrame(const RtdVideoFrame& frame) {
       RTC_LOG(LS_INFO) << "First key frame arrived after requesting I-frame, begin to push to queue.";
     } else {
       RTC_LOG(LS_WARNING) << "Discard non-key frame after requesting I-frame.";
+      video_discarded_.fetch_add(1, std::memory_order_relaxed);
+      // Repeats the request once the engine's interval has passed, in case
+      // the PLI or the key frame got lost.
+      RequestKeyFrame();
       return;
     }
   }
  
-  if (!video_queue_->WriteBack(frame.data, frame.size, frame.play_timestamp_ms, frame.timestamp_ms, 0, flag)) {
+  if (!flag && frame.codec_type == RtdVideoCodecType::RTD_H264 &&
+      IsDisposableH264Frame(frame.data, frame.size)) {
+    flag |= kRtdFrameDisposable;
+  }
+  if (video_discontinuity_) {
+    flag |= kRtdFrameDiscontinuity;
+  }
+
+  if (!video_queue_->WriteBack(frame.data, frame.size, frame.play_timestamp_ms, frame.timestamp_ms, 0, flag) &&
+      !(MakeVideoRoom() &&
+        video_queue_->WriteBack(frame.data, frame.size, frame.play_timestamp_ms, frame.timestamp_ms, 0, flag))) {
+    video_discarded_.fetch_add(1, std::memory_order_relaxed);
     if (last_video_receive_failed_) {   // reduce duplicated failing process
       return;
     }
 
     RTC_LOG(LS_ERROR) << "Failed to add video frame to queue, discard current video packet.";
-    iframe_requested_ = true;
+    RequestKeyFrame();
     video_queue_->Clear();
     last_video_receive_failed_ = true;
   } else {
     if (last_video_receive_failed_) {
       last_video_receive_failed_ = false;
     }
+    video_discontinuity_ = false;
+    TrimVideoQueue(frame.play_timestamp_ms);
+    video_queue_ms_ = static_cast<int>(video_queue_->BufferedMs());
+    NotifyFrameAvailable(video_waiter_);
   }
 }
 
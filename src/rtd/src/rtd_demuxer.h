@@ -1,36 +1,100 @@
 #ifndef RTD_DEMUXER_H_
 #define RTD_DEMUXER_H_
 
+#include <atomic>
+
+#include "api/scoped_refptr.h"
+#include "rtc_base/event.h"
+#include "rtc_base/ref_counted_object.h"
 #include "rtd_engine_interface.h"
 #include "rtd_frame_queue.h"
 #include "rtd_def.h"
 namespace webrtc {
 namespace rtd {
 
+// Lets a reader sleep until the producer queues a frame.
+struct RtdFrameWaiter {
+  rtc::Event event;
+  std::atomic<int> waiting{0};
+};
+
 class RtdDemuxer : public RtdSinkInterface {
  public:
   RtdDemuxer(RtdConf conf);
   ~RtdDemuxer();
   int Open(const std::string& url, const char* mode = "r");
   int ReadFrame(RtdFrame*& frame);
+  // Same as ReadFrame(), but sleeps up to |timeout_ms| for a frame to arrive.
+  int ReadFrame(RtdFrame*& frame, int timeout_ms);
+  // Reads from one media queue only (RtdReadMedia). An audio and a video
+  // reader may run on separate threads, each owning its queue's read side.
+  int ReadMediaFrame(int media, RtdFrame*& frame, int timeout_ms);
+  // Reads up to |max_count| queued frames in ReadFrame() order.
+  int ReadFrames(RtdFrame** frames, int max_count, int* count);
 
   // set/get parameters
   int Command(const char* cmd, void* arg);
   int Close();
-  void FreeFrame(RtdFrame* frame);
+  // Frees a frame returned by ReadFrame(). Does not need the demuxer, frames
+  // may be freed from any thread and after the demuxer is gone.
+  static void FreeFrame(RtdFrame* frame);
+  static void FreeFrames(RtdFrame* const* frames, int count);
 
   // RtdSinkInterface implementation
   void OnAudioFrame(const RtdAudioFrame& frame) override;
+  void OnEncodedAudioFrame(const RtdEncodedAudioFrame& frame) override;
   void OnVideoFrame(const RtdVideoFrame& frame) override;
 
  private:
+  int ReadFrameInterleaved(RtdFrame*& frame);
+  int ReadVideoFrame(RtdFrame*& frame);
+  int ReadAudioFrame(RtdFrame*& frame);
+  RtdFrame* ExportFrame(RtdFrameBuffer* buffer, int is_audio);
+  int ReadFrameTimed(int media, RtdFrame*& frame, int timeout_ms);
+  bool HasQueuedFrame(int media);
+  // How much longer the interleave gate holds back the one queued media,
+  // 0 if it does not.
+  int64_t SkewWaitMs(int64_t now_ms) const;
+  // Wakes readers blocked on |waiter| or on both queues. Producer side.
+  void NotifyFrameAvailable(RtdFrameWaiter& waiter);
+  // Queues the pcm merged so far as one audio frame. Producer side.
+  void FlushPendingAudio();
+  void WriteAudioFrame(const void* data, size_t size, int64_t pts, int duration);
+  // Drops queued video no kept frame depends on: non-reference frames, then
+  // the ends of GOPs. Returns false if nothing could go. Video producer side.
+  bool MakeVideoRoom();
+  // Waits for the next key frame and asks the sender for one.
+  void RequestKeyFrame();
+  // Moves the open stream to |url|, see RtdEngineInterface::Switch().
+  int Switch(const std::string& url);
+  // Drop what is queued of the old stream and flag the next frame, once
+  // per Switch(). Producer side.
+  void StartAudioAfterSwitch();
+  void StartVideoAfterSwitch();
+  // Drops the oldest video down to |max_buffer_ms_|, |newest_pts| being the
+  // frame just queued, and has the audio before the cut dropped too. Video
+  // producer side.
+  void TrimVideoQueue(int64_t newest_pts);
+  // Drops the audio before the cut TrimVideoQueue() made, and the oldest
+  // audio down to |max_buffer_ms_|. Audio producer side.
+  void TrimAudioQueue();
+
   std::unique_ptr<RtdEngineInterface> rtd_engine_;
   RtdConf conf_;
-  std::unique_ptr<RtdFrameQueue> video_queue_;
-  std::unique_ptr<RtdFrameQueue> audio_queue_;
-  std::unique_ptr<RtdFrame> frame_;
-  RtdFrameBuffer* current_frame_buffer_;
+  rtc::scoped_refptr<RtdFrameQueue> video_queue_;
+  rtc::scoped_refptr<RtdFrameQueue> audio_queue_;
   bool last_audio_receive_failed_;
+  int audio_output_;
+  int thread_mode_;
+  std::atomic<int> audio_packet_ms_;
+  // PCM merged into the next audio frame, producer side.
+  rtc::Buffer pending_audio_;
+  int64_t pending_audio_pts_;
+  int64_t pending_audio_end_rtp_;   // rtp timestamp right after the pending pcm
+  size_t pending_audio_samples_;    // per channel
+  int pending_audio_sample_rate_;
+  size_t pending_audio_channels_;
+  int64_t last_encoded_audio_rtp_;  // -1 before the first encoded frame
   bool last_video_receive_failed_;
 
   bool iframe_requested_;
@@ -38,6 +102,42 @@ class RtdDemuxer : public RtdSinkInterface {
   int64_t video_log_print_last_;
   int64_t read_audio_frame_last_;
   int64_t read_video_frame_last_;
+
+  RtdReadMode read_mode_;
+  int max_skew_ms_;
+  bool audio_read_;
+  bool video_read_;
+  uint64_t last_audio_dts_;
+  uint64_t last_video_dts_;
+  int64_t skew_wait_start_ms_;
+
+  std::atomic<int> max_buffer_ms_;
+  std::atomic<int64_t> pending_audio_trim_pts_;   // -1 if none
+
+  // Set by Switch(), taken by the producers at the first new frame.
+  std::atomic<bool> audio_switched_;
+  std::atomic<bool> video_switched_;
+  // Flag the next queued frame kRtdFrameDiscontinuity, producer side.
+  bool audio_discontinuity_;
+  bool video_discontinuity_;
+
+  // Startup metrics of the read side, ms since Open() or Switch(), -1 until
+  // the first frame of the media is read.
+  std::atomic<int64_t> open_time_ms_;
+  std::atomic<int> first_audio_read_ms_;
+  std::atomic<int> first_video_read_ms_;
+
+  // For "getStats". Queue spans as of the last write, producer side.
+  std::atomic<int> audio_queue_ms_;
+  std::atomic<int> video_queue_ms_;
+  // Frames that never made it into a queue.
+  std::atomic<uint64_t> audio_discarded_;
+  std::atomic<uint64_t> video_discarded_;
+
+  RtdFrameWaiter any_waiter_;
+  RtdFrameWaiter audio_waiter_;
+  RtdFrameWaiter video_waiter_;
+  std::atomic<bool> closed_;
 };
 
 } // namespace rtd
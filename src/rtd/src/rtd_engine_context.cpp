@@ -0,0 +1,55 @@
+#include "rtd_engine_context.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/synchronization/mutex.h"
+
+namespace webrtc {
+namespace rtd {
+
+namespace {
+
+Mutex g_context_mutex;
+// Not owning, engines hold the references.
+std::weak_ptr<RtdEngineContext> g_context;
+
+} // namespace
+
+std::shared_ptr<RtdEngineContext> RtdEngineContext::Acquire() {
+  MutexLock lock(&g_context_mutex);
+  std::shared_ptr<RtdEngineContext> context = g_context.lock();
+  if (context) {
+    return context;
+  }
+
+  context.reset(new RtdEngineContext());
+  if (!context->Start()) {
+    return nullptr;
+  }
+  g_context = context;
+  return context;
+}
+
+bool RtdEngineContext::Start() {
+  RTC_LOG(LS_INFO) << "RtdEngineContext::Start()";
+  network_thread_ = rtc::Thread::CreateWithSocketServer();
+  network_thread_->SetName("Network Thread", nullptr);
+  if (!network_thread_->Start()) {
+    RTC_LOG(LS_ERROR) << "network thread start failed.";
+    return false;
+  }
+
+  worker_thread_ = rtc::Thread::Create();
+  worker_thread_->SetName("Worker Thread", nullptr);
+  if (!worker_thread_->Start()) {
+    RTC_LOG(LS_ERROR) << "worker thread start failed.";
+    return false;
+  }
+
+  return true;
+}
+
+RtdEngineContext::~RtdEngineContext() {
+  RTC_LOG(LS_INFO) << "RtdEngineContext::~RtdEngineContext()";
+}
+
+} // namespace rtd
+} // namespace webrtc
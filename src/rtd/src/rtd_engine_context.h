@@ -0,0 +1,36 @@
+#ifndef RTD_ENGINE_CONTEXT_H_
+#define RTD_ENGINE_CONTEXT_H_
+
+#include <memory>
+
+#include "rtc_base/thread.h"
+
+namespace webrtc {
+namespace rtd {
+
+// Network and worker threads shared by all engines of the process. Every
+// engine builds its peer connection factory on them instead of starting its
+// own pair. Created with the first engine, stopped when the last one lets go.
+class RtdEngineContext {
+ public:
+  // Returns the running context, or starts one. Null if the threads failed
+  // to start.
+  static std::shared_ptr<RtdEngineContext> Acquire();
+
+  ~RtdEngineContext();
+
+  rtc::Thread* network_thread() const { return network_thread_.get(); }
+  rtc::Thread* worker_thread() const { return worker_thread_.get(); }
+
+ private:
+  RtdEngineContext() = default;
+  bool Start();
+
+  std::unique_ptr<rtc::Thread> network_thread_;
+  std::unique_ptr<rtc::Thread> worker_thread_;
+};
+
+} // namespace rtd
+} // namespace webrtc
+
+#endif // !RTD_ENGINE_CONTEXT_H_
@@ -1,4 +1,6 @@
 #include "rtd_engine_impl.h"
+#include <string.h>
+#include <algorithm>
 #include "rtd_def.h"
 
 #include "api/create_peerconnection_factory.h"
@@ -6,16 +8,117 @@
 #include "api/audio_codecs/builtin_audio_decoder_factory.h"
 #include "api/video_codecs/builtin_video_encoder_factory.h"
 #include "api/video_codecs/builtin_video_decoder_factory.h"
+#include "media/base/media_channel.h"
 #include "modules/audio_device/include/fake_audio_device_impl.h"
+#include "pc/channel.h"
+#include "pc/rtp_transceiver.h"
 #include "pc/session_description.h"
+#include "absl/strings/match.h"
 #include "rtc_base/checks.h"
 #include "rtc_base/logging.h"
 #include "rtc_base/message_digest.h"
 #include "rtc_base/event_tracer.h"
+#include "rtc_base/task_utils/to_queued_task.h"
 
 namespace {
 
 constexpr char kRtdSdkVersion[] = "v1.1.0";
+constexpr int kRtdPassthroughClockKhz = 48;   // NetEq timestamps of AAC and Opus
+constexpr int kRtdVideoClockKhz = 90;
+constexpr size_t kRtdAscBitOffset = 15;       // AudioSpecificConfig in StreamMuxConfig
+constexpr int64_t kRtdKeyFrameRequestIntervalMs = 300;  // min gap between PLIs we ask for
+constexpr int kRtdPrepareTimeoutMs = 5000;    // for the offer of a prepared engine
+constexpr int64_t kRtdStaleMediaMaxMs = 3000; // old stream buffered after a switch
+constexpr int64_t kRtdSenderReportPollMs = 1000;  // senders report about every second
+
+// The voice and video media channels of |peer_connection|. Signaling thread,
+// channels are only destroyed there.
+void FindMediaChannels(webrtc::PeerConnectionInterface* peer_connection,
+                       cricket::VoiceMediaChannel** voice_channel,
+                       cricket::VideoMediaChannel** video_channel) {
+  *voice_channel = nullptr;
+  *video_channel = nullptr;
+  for (const auto& transceiver : peer_connection->GetTransceivers()) {
+    cricket::ChannelInterface* channel =
+        static_cast<webrtc::RtpTransceiverProxyWithInternal<webrtc::RtpTransceiver>*>(transceiver.get())
+            ->internal()->channel();
+    if (!channel) {
+      continue;
+    }
+    if (channel->media_type() == cricket::MEDIA_TYPE_AUDIO) {
+      *voice_channel = static_cast<cricket::VoiceChannel*>(channel)->media_channel();
+    } else if (channel->media_type() == cricket::MEDIA_TYPE_VIDEO) {
+      *video_channel = static_cast<cricket::VideoChannel*>(channel)->media_channel();
+    }
+  }
+}
+
+// The rtp and jitter buffer fields of |stats|, from the first receiver of
+// each media; -1 for a media without one.
+void FillReceiveStats(const cricket::VoiceMediaInfo& voice_info,
+                      const cricket::VideoMediaInfo& video_info,
+                      RtdStats& stats) {
+  if (!voice_info.receivers.empty()) {
+    const cricket::VoiceReceiverInfo& audio = voice_info.receivers[0];
+    stats.audio_packets_received = audio.packets_rcvd;
+    stats.audio_packets_lost = audio.packets_lost;
+    stats.audio_jitter_ms = audio.jitter_ms;
+    stats.audio_nacks_sent = static_cast<int>(audio.nacks_sent.value_or(0));
+    stats.audio_buffer_ms = audio.jitter_buffer_ms;
+    stats.audio_target_buffer_ms = audio.jitter_buffer_preferred_ms;
+    stats.audio_expand_rate = audio.expand_rate;
+    stats.audio_accelerate_rate = audio.accelerate_rate;
+    stats.audio_preemptive_rate = audio.preemptive_expand_rate;
+  } else {
+    stats.audio_packets_received = stats.audio_packets_lost = stats.audio_jitter_ms = -1;
+    stats.audio_nacks_sent = stats.audio_buffer_ms = stats.audio_target_buffer_ms = -1;
+    stats.audio_expand_rate = stats.audio_accelerate_rate = stats.audio_preemptive_rate = -1;
+  }
+
+  if (!video_info.receivers.empty()) {
+    const cricket::VideoReceiverInfo& video = video_info.receivers[0];
+    stats.video_packets_received = video.packets_rcvd;
+    stats.video_packets_lost = video.packets_lost;
+    stats.video_jitter_ms = static_cast<int>(video.jitter_ms);
+    stats.video_nacks_sent = static_cast<int>(video.nacks_sent.value_or(0));
+    stats.video_rtx_received = static_cast<int>(video.rtx_packets_rcvd);
+    stats.video_buffered_frames = video.buffered_frames;
+    stats.video_jitter_buffer_ms = video.jitter_buffer_ms;
+  } else {
+    stats.video_packets_received = stats.video_packets_lost = stats.video_jitter_ms = -1;
+    stats.video_nacks_sent = stats.video_rtx_received = -1;
+    stats.video_buffered_frames = stats.video_jitter_buffer_ms = -1;
+  }
+}
+
+// OpusHead (RFC 7845), channel mapping family 0.
+std::vector<uint8_t> MakeOpusHead(int channels) {
+  return {'O', 'p', 'u', 's', 'H', 'e', 'a', 'd',
+          1, static_cast<uint8_t>(channels),
+          0x38, 0x01,               // pre-skip 312
+          0x80, 0xbb, 0x00, 0x00,   // 48000Hz
+          0x00, 0x00,               // output gain
+          0x00};
+}
+
+// The AudioSpecificConfig inside a StreamMuxConfig (fmtp "config" of
+// MP4A-LATM). The StreamMuxConfig fields after it are kept, decoders stop
+// reading at the end of the AudioSpecificConfig.
+std::vector<uint8_t> AscFromStreamMuxConfig(const uint8_t* smc, size_t size) {
+  std::vector<uint8_t> asc;
+  if (size * 8 <= kRtdAscBitOffset) {
+    return asc;
+  }
+  asc.resize((size * 8 - kRtdAscBitOffset + 7) / 8);
+  for (size_t i = 0; i < asc.size(); ++i) {
+    size_t bit = kRtdAscBitOffset + i * 8;
+    size_t byte = bit / 8;
+    size_t shift = bit % 8;
+    uint8_t next = byte + 1 < size ? smc[byte + 1] : 0;
+    asc[i] = static_cast<uint8_t>((smc[byte] << shift) | (shift ? next >> (8 - shift) : 0));
+  }
+  return asc;
+}
 
 } // namespace
 
@@ -43,19 +146,24 @@ class RtcSetLocalSessionDescriptionObserver : public SetSessionDescriptionObserv
 
 class RtcSetRemoteSessionDescriptionObserver : public SetSessionDescriptionObserver {
  public:
-  static RtcSetRemoteSessionDescriptionObserver* Create() {
-    return new rtc::RefCountedObject<RtcSetRemoteSessionDescriptionObserver>();
+  static RtcSetRemoteSessionDescriptionObserver* Create(RtdEngineImpl* rtd_engine) {
+    return new rtc::RefCountedObject<RtcSetRemoteSessionDescriptionObserver>(rtd_engine);
   }
 
   virtual void OnSuccess() { 
     RTC_LOG(LS_INFO) << "SetRemoteDescription Success"; 
+    signal_remote_description_set_();
   }
   virtual void OnFailure(RTCError error) {
     RTC_LOG(LS_ERROR) << "SetRemoteDescription failed: " << ToString(error.type()) << ": " << error.message();
   }
 
+  sigslot::signal0<> signal_remote_description_set_;
+
  protected:
-  RtcSetRemoteSessionDescriptionObserver() {}
+  RtcSetRemoteSessionDescriptionObserver(RtdEngineImpl* rtd_engine) {
+    signal_remote_description_set_.connect(rtd_engine, &RtdEngineImpl::OnRemoteDescriptionSet);
+  }
   ~RtcSetRemoteSessionDescriptionObserver() {}
 };
 
@@ -90,40 +198,105 @@ RtdEngineImpl::RtdEngineImpl(
     RtdSinkInterface* sink,
     const std::string& url,
     RtdConf conf)
-    : worker_thread_(nullptr),
-      network_thread_(nullptr),
-      signaling_thread_(nullptr),
+    : signaling_thread_(nullptr),
+      thread_mode_(RTD_THREAD_OWN_SIGNALING),
       peer_connection_(nullptr),
       peer_connection_factory_(nullptr),
       conf_(conf),
       url_(url),
       sink_(sink),
       clock_(Clock::GetRealTimeClock()),
+      media_clock_(clock_),
       signaling_(new RtdSignaling(url)),
       stream_info_parsed_(false),
       enable_audio_(true),
       enable_video_(true),
       sample_rate_(48000),
       channels_(2),
+      audio_passthrough_(false),
+      audio_codec_(RTD_AUDIO_CODEC_PCM_S16LE),
       start_open_time_ms_(0),
+      receive_stats_(),
       first_video_frame_duration_(0),
       first_audio_frame_duration_(0),
       first_audio_frame_received_(false),
       first_video_frame_received_(false),
+      first_key_frame_received_(false),
       media_conn_status_(RTD_MEDIA_CONN_NONE),
       stream_stopped_(false),
-      is_stopped_(false) {
+      is_stopped_(false),
+      last_key_frame_request_ms_(0),
+      prepared_(false),
+      signaling_safety_(PendingTaskSafetyFlag::CreateDetached()),
+      engine_safety_(PendingTaskSafetyFlag::CreateDetached()),
+      switching_(false),
+      stale_media_deadline_ms_(0) {
+  for (auto& ssrc : stale_ssrc_) {
+    ssrc = 0;
+  }
   RTC_LOG(LS_INFO) << "RtcEngineImpl::RtcEngineImpl() SDK_VERSION:" << kRtdSdkVersion;
+  ResetStartupMetrics();
+  FillReceiveStats(cricket::VoiceMediaInfo(), cricket::VideoMediaInfo(), receive_stats_);
 }
 
 RtdEngineImpl::~RtdEngineImpl() {
   RTC_LOG(LS_INFO) << "RtcEngineImpl::~RtcEngineImpl()";
+  // Cancels a pending request, whose callback uses the members below.
+  signaling_.reset();
   sink_ = nullptr;
 }
 
+void RtdEngineImpl::SetAudioOutput(int output) {
+  RTC_LOG(LS_INFO) << "RtdEngineImpl::SetAudioOutput() output:" << output;
+  audio_passthrough_ = output == RTD_AUDIO_OUTPUT_ENCODED;
+}
+
+void RtdEngineImpl::SetThreadMode(int mode) {
+  RTC_LOG(LS_INFO) << "RtdEngineImpl::SetThreadMode() mode:" << mode;
+  thread_mode_ = mode;
+}
+
+bool RtdEngineImpl::Prepare() {
+  RTC_LOG(LS_INFO) << "RtdEngineImpl::Prepare().";
+  prepared_ = true;
+  if (!InitializePeerConnection() || !CreateOffer()) {
+    RTC_LOG(LS_ERROR) << "RtdEngineImpl::Prepare() peerconnection failed.";
+    return false;
+  }
+
+  if (!offer_ready_.Wait(kRtdPrepareTimeoutMs)) {
+    RTC_LOG(LS_ERROR) << "RtdEngineImpl::Prepare() no offer in " << kRtdPrepareTimeoutMs << "ms.";
+    return false;
+  }
+
+  return true;
+}
+
+void RtdEngineImpl::Attach(RtdSinkInterface* sink, const std::string& url, RtdConf conf) {
+  RTC_LOG(LS_INFO) << "RtdEngineImpl::Attach().";
+  sink_ = sink;
+  url_ = url;
+  conf_ = conf;
+  signaling_.reset(new RtdSignaling(url));
+}
+
 int RtdEngineImpl::Open() {
   RTC_LOG(LS_INFO) << "RtdEngineImpl::Open().";
-  start_open_time_ms_ = clock_->TimeInMilliseconds();
+  ResetStartupMetrics();
+  if (prepared_) {
+    {
+      MutexLock lock(&metrics_mutex_);
+      startup_metrics_.threads_started_ms = 0;
+      startup_metrics_.factory_created_ms = 0;
+      startup_metrics_.offer_created_ms = 0;
+    }
+    // Peer connection and offer are ready, only signaling is left.
+    signaling_thread_->PostTask(ToQueuedTask(signaling_safety_, [this] {
+      OnSdpOffer(prepared_offer_);
+    }));
+    return RTD_ERROR_OPEN_SUCCESS;
+  }
+
   if (!InitializePeerConnection()) {
     RTC_LOG(LS_ERROR) << "InitializePeerConnection failed.";
     return RTD_ERROR_UNINITIALIZE;
@@ -140,35 +313,44 @@ int RtdEngineImpl::Open() {
 void RtdEngineImpl::Close() {
   RTC_LOG(LS_INFO) << "RtcEngineImpl::Close()";
   is_stopped_ = true;
+  if (signaling_thread_) {
+    // Does not wait for a slow signaling server, the request is aborted.
+    signaling_thread_->Invoke<void>(RTC_FROM_HERE, [this] {
+      signaling_safety_->SetNotAlive();
+      engine_safety_->SetNotAlive();
+      sender_report_poll_.Stop();
+      if (signaling_) {
+        signaling_->Cancel();
+      }
+    });
+  }
   DeletePeerConnection();
 }
 
 bool RtdEngineImpl::InitializePeerConnection() {
   RTC_LOG(LS_INFO) << "RtcEngineImpl::Init()";
-  network_thread_ = rtc::Thread::CreateWithSocketServer();
-  network_thread_->SetName("Network Thread", nullptr);
-  if (!network_thread_->Start()) {
-    RTC_LOG(LS_ERROR) << "network thread start failed.";
-    return false;
-  }
-
-  worker_thread_ = rtc::Thread::Create();
-  worker_thread_->SetName("Worker Thread", nullptr);
-  if (!worker_thread_->Start()) {
-    RTC_LOG(LS_ERROR) << "worker thread start failed.";
+  context_ = RtdEngineContext::Acquire();
+  if (!context_) {
+    RTC_LOG(LS_ERROR) << "engine context start failed.";
     return false;
   }
 
-  signaling_thread_ = rtc::Thread::Create();
-  signaling_thread_->SetName("Signaling Thread", nullptr);
-  if (!signaling_thread_->Start()) {
-    RTC_LOG(LS_ERROR) << "signaling thread start failed.";
-    return false;
+  if (thread_mode_ == RTD_THREAD_SHARED_SIGNALING) {
+    signaling_thread_ = context_->worker_thread();
+  } else {
+    own_signaling_thread_ = rtc::Thread::Create();
+    own_signaling_thread_->SetName("Signaling Thread", nullptr);
+    if (!own_signaling_thread_->Start()) {
+      RTC_LOG(LS_ERROR) << "signaling thread start failed.";
+      return false;
+    }
+    signaling_thread_ = own_signaling_thread_.get();
   }
+  MarkStartupPhase(&RtdStartupMetrics::threads_started_ms);
 
-  peer_connection_factory_ = CreatePeerConnectionFactory(network_thread_.get(), worker_thread_.get(), signaling_thread_.get(), 
+  peer_connection_factory_ = CreatePeerConnectionFactory(context_->network_thread(), context_->worker_thread(), signaling_thread_, 
                                                          rtc::make_ref_counted<FakeAudioDeviceImpl>(),
-                                                         CreateBuiltinAudioEncoderFactory(), rtc::make_ref_counted<RtdAudioDecoderFactory>(this, this),
+                                                         CreateBuiltinAudioEncoderFactory(), rtc::make_ref_counted<RtdAudioDecoderFactory>(this, this, audio_passthrough_),
                                                          CreateBuiltinVideoEncoderFactory(), std::make_unique<RtdVideoDecoderFactory>(this),
 														                             nullptr, nullptr);
   if (!peer_connection_factory_) {
@@ -176,6 +358,7 @@ bool RtdEngineImpl::InitializePeerConnection() {
     DeletePeerConnection();
     return false;
   }
+  MarkStartupPhase(&RtdStartupMetrics::factory_created_ms);
 
   PeerConnectionFactoryInterface::Options option;
   option.disable_encryption = true;
@@ -249,11 +432,11 @@ bool RtdEngineImpl::AddTransceiver(cricket::MediaType type) {
   return true;
 }
 
-bool RtdEngineImpl::CreateOffer() {
+bool RtdEngineImpl::CreateOffer(bool ice_restart) {
   if (!signaling_thread_->IsCurrent()) {
-    return signaling_thread_->Invoke<bool>(RTC_FROM_HERE, [this] { return CreateOffer(); });
+    return signaling_thread_->Invoke<bool>(RTC_FROM_HERE, [this, ice_restart] { return CreateOffer(ice_restart); });
   }
-  RTC_LOG(LS_INFO) << "RtcEngineImpl::CreateOffer()";
+  RTC_LOG(LS_INFO) << "RtcEngineImpl::CreateOffer() ice_restart:" << ice_restart;
 
   if (!peer_connection_) {
     RTC_LOG(LS_ERROR) << "peerconnection is nullptr.";
@@ -263,6 +446,7 @@ bool RtdEngineImpl::CreateOffer() {
   PeerConnectionInterface::RTCOfferAnswerOptions options;
   options.offer_to_receive_audio = true;
   options.offer_to_receive_video = true;
+  options.ice_restart = ice_restart;
   peer_connection_->CreateOffer(RtcCreateSessionDescriptionObserver::Create(this), options);
   return true;
 }
@@ -272,8 +456,15 @@ void RtdEngineImpl::SetLocalDescription(SessionDescriptionInterface* desc) {
   peer_connection_->SetLocalDescription(RtcSetLocalSessionDescriptionObserver::Create(), desc);
   if (desc->GetType() == SdpType::kOffer) {
     RTC_LOG(LS_INFO) << "desc is offer.";
+    MarkStartupPhase(&RtdStartupMetrics::offer_created_ms);
     std::string sdp;
     desc->ToString(&sdp);
+    if (prepared_) {
+      // Sent by Open() once the engine has its stream.
+      prepared_offer_ = sdp;
+      offer_ready_.Set();
+      return;
+    }
     OnSdpOffer(sdp);
   }
 }
@@ -298,7 +489,7 @@ bool RtdEngineImpl::SetAnswer(const std::string& answer_sdp) {
   ParseStreamInfo(session_description);
 
   RTC_LOG(LS_INFO) << "RtcEngineImpl::SetRemoteDescription()";
-  peer_connection_->SetRemoteDescription(RtcSetRemoteSessionDescriptionObserver::Create(), session_description);
+  peer_connection_->SetRemoteDescription(RtcSetRemoteSessionDescriptionObserver::Create(this), session_description);
   return true;
 }
 
@@ -311,6 +502,9 @@ void RtdEngineImpl::ParseStreamInfo(SessionDescriptionInterface* session_descrip
       enable_audio_ = true;
       sample_rate_ = codec.clockrate;
       channels_ = codec.channels;
+      if (audio_passthrough_) {
+        ParseAudioCodec(codec.name, codec.clockrate, codec.channels, codec.params);
+      }
     } else if (content.media_description()->type() == cricket::MEDIA_TYPE_VIDEO) {
       enable_video_ = true;
     }
@@ -318,30 +512,199 @@ void RtdEngineImpl::ParseStreamInfo(SessionDescriptionInterface* session_descrip
   stream_info_parsed_ = true;
 }
 
+void RtdEngineImpl::ParseAudioCodec(const std::string& name, int clockrate_hz, size_t channels,
+                                    const SdpAudioFormat::Parameters& params) {
+  SdpAudioFormat format(name, clockrate_hz, channels, params);
+  audio_extradata_.clear();
+  if (absl::EqualsIgnoreCase(name, "opus")) {
+    audio_codec_ = RTD_AUDIO_CODEC_OPUS;
+    audio_extradata_ = MakeOpusHead(static_cast<int>(channels));
+  } else if (absl::EqualsIgnoreCase(name, "MP4A-ADTS")) {
+    audio_codec_ = RTD_AUDIO_CODEC_AAC;
+  } else if (absl::EqualsIgnoreCase(name, "MP4A-LATM")) {
+    if (format.IsCPresented()) {
+      audio_codec_ = RTD_AUDIO_CODEC_AAC_LATM;
+    } else {
+      uint32_t config_channels = 0;
+      uint32_t config_sample_rate = 0;
+      bool sbr_enabled = false;
+      bool ps_enabled = false;
+      rtc::BufferT<uint8_t> smc;
+      if (!format.GetInfoFromConfig(config_channels, config_sample_rate, sbr_enabled, ps_enabled, smc)) {
+        RTC_LOG(LS_ERROR) << "RtdEngineImpl::ParseAudioCodec() bad MP4A-LATM config.";
+      }
+      audio_codec_ = RTD_AUDIO_CODEC_AAC;
+      audio_extradata_ = AscFromStreamMuxConfig(smc.data(), smc.size());
+    }
+  } else {
+    RTC_LOG(LS_WARNING) << "RtdEngineImpl::ParseAudioCodec() no passthrough for " << name;
+    audio_codec_ = RTD_AUDIO_CODEC_PCM_S16LE;
+  }
+  RTC_LOG(LS_INFO) << "RtdEngineImpl::ParseAudioCodec() name:" << name << " codec:" << audio_codec_
+                   << " extradata_len:" << audio_extradata_.size();
+}
+
+void RtdEngineImpl::FillStreamInfo(RtdDemuxInfo& info) {
+  info.audio_enabled = enable_audio_;
+  info.video_enabled = enable_video_;
+  info.audio_sample_rate = sample_rate_;
+  info.audio_channels = channels_;
+}
+
 int RtdEngineImpl::GetStreamInfo(RtdDemuxInfo& info) {
   if (media_conn_status_ == RTD_MEDIA_CONN_FAILED) {
     return -1;
   }
 
   if (stream_info_parsed_ && media_conn_status_ == RTD_MEDIA_CONN_SUCCESS) {
-    info.audio_enabled = enable_audio_;
-    info.video_enabled = enable_video_;
-    info.audio_sample_rate = sample_rate_;
-    info.audio_channels = channels_;
+    FillStreamInfo(info);
     return 1;
   }
 
   return 0;
 }
 
+int RtdEngineImpl::GetAudioCodecInfo(RtdAudioCodecInfo& info) {
+  if (!stream_info_parsed_) {
+    return -1;
+  }
+
+  info.codec = audio_codec_;
+  info.extradata_len = 0;
+  if (audio_extradata_.size() <= sizeof(info.extradata)) {
+    memcpy(info.extradata, audio_extradata_.data(), audio_extradata_.size());
+    info.extradata_len = static_cast<int>(audio_extradata_.size());
+  }
+  return 0;
+}
+
+void RtdEngineImpl::RequestKeyFrame() {
+  if (!signaling_thread_ || !peer_connection_) {
+    return;
+  }
+  if (!signaling_thread_->IsCurrent()) {
+    signaling_thread_->PostTask(ToQueuedTask(engine_safety_, [this] { RequestKeyFrame(); }));
+    return;
+  }
+  // Callers repeat the request while they wait, one lost PLI is retried.
+  int64_t now_ms = clock_->TimeInMilliseconds();
+  if (now_ms - last_key_frame_request_ms_ < kRtdKeyFrameRequestIntervalMs) {
+    return;
+  }
+
+  cricket::VideoMediaChannel* video_channel = nullptr;
+  rtc::scoped_refptr<RtpReceiverInternal> video_receiver;
+  for (const auto& transceiver : peer_connection_->GetTransceivers()) {
+    RtpTransceiver* internal =
+        static_cast<RtpTransceiverProxyWithInternal<RtpTransceiver>*>(transceiver.get())->internal();
+    cricket::ChannelInterface* channel = internal->channel();
+    if (channel && channel->media_type() == cricket::MEDIA_TYPE_VIDEO) {
+      video_channel = static_cast<cricket::VideoChannel*>(channel)->media_channel();
+      video_receiver = internal->receiver_internal();
+      break;
+    }
+  }
+  if (!video_channel) {
+    return;
+  }
+
+  RTC_LOG(LS_INFO) << "RtdEngineImpl::RequestKeyFrame() sending PLI.";
+  last_key_frame_request_ms_ = now_ms;
+  // The receive stream sends the PLI right away, without waiting for a
+  // frame to pass through the decoder. 0 is the unsignaled stream.
+  context_->worker_thread()->Invoke<void>(RTC_FROM_HERE, [&] {
+    video_channel->GenerateKeyFrame(video_receiver ? video_receiver->ssrc().value_or(0) : 0);
+  });
+}
+
+int RtdEngineImpl::Switch(const std::string& url) {
+  if (!signaling_thread_ || !peer_connection_) {
+    return -1;
+  }
+  if (!signaling_thread_->IsCurrent()) {
+    return signaling_thread_->Invoke<int>(RTC_FROM_HERE, [this, &url] { return Switch(url); });
+  }
+  RTC_LOG(LS_INFO) << "RtdEngineImpl::Switch() url:" << url;
+  // Old stream out first: its pending request, queued answer and media.
+  switching_ = true;
+  if (signaling_) {
+    signaling_->Cancel();
+  }
+  signaling_safety_->SetNotAlive();
+  signaling_safety_ = PendingTaskSafetyFlag::CreateDetached();
+  stale_ssrc_[kRtdClockAudio] = media_clock_.Ssrc(kRtdClockAudio);
+  stale_ssrc_[kRtdClockVideo] = media_clock_.Ssrc(kRtdClockVideo);
+  media_clock_.Rebase();
+
+  url_ = url;
+  signaling_.reset(new RtdSignaling(url));
+  prepared_ = false;
+  ResetStartupMetrics();
+  {
+    MutexLock lock(&metrics_mutex_);
+    startup_metrics_.threads_started_ms = 0;
+    startup_metrics_.factory_created_ms = 0;
+  }
+  first_audio_frame_received_ = false;
+  first_video_frame_received_ = false;
+  first_key_frame_received_ = false;
+  // Factory, threads and transceivers stay, the new server gets a fresh
+  // offer and ICE restarts towards it.
+  return CreateOffer(true) ? 0 : -1;
+}
+
+void RtdEngineImpl::ResetStartupMetrics() {
+  MutexLock lock(&metrics_mutex_);
+  start_open_time_ms_ = clock_->TimeInMilliseconds();
+  memset(&startup_metrics_, 0xff, sizeof(startup_metrics_));   // all -1
+}
+
+void RtdEngineImpl::MarkStartupPhase(int RtdStartupMetrics::*phase) {
+  MutexLock lock(&metrics_mutex_);
+  if (startup_metrics_.*phase < 0) {
+    startup_metrics_.*phase = static_cast<int>(clock_->TimeInMilliseconds() - start_open_time_ms_);
+  }
+}
+
+void RtdEngineImpl::GetStartupMetrics(RtdStartupMetrics& metrics) {
+  MutexLock lock(&metrics_mutex_);
+  metrics = startup_metrics_;
+}
+
+int RtdEngineImpl::GetStats(RtdStats& stats) {
+  if (!signaling_thread_ || !peer_connection_) {
+    return -1;
+  }
+
+  // The receive side as of the last PollSenderReports(), so a poll from the
+  // player never waits on the signaling or worker thread.
+  MutexLock lock(&metrics_mutex_);
+  stats = receive_stats_;
+  if (audio_decode_.decoded > 0) {
+    stats.audio_decoded_frames = static_cast<int>(audio_decode_.decoded);
+    stats.audio_decoded_ahead = static_cast<int>(audio_decode_.decoded_ahead);
+    stats.audio_decode_avg_us = static_cast<int>(audio_decode_.total_us / audio_decode_.decoded);
+    stats.audio_decode_max_us = static_cast<int>(audio_decode_.max_us);
+    stats.audio_decode_late = static_cast<int>(audio_decode_.late);
+  } else {
+    stats.audio_decoded_frames = stats.audio_decoded_ahead = -1;
+    stats.audio_decode_avg_us = stats.audio_decode_max_us = stats.audio_decode_late = -1;
+  }
+  return 0;
+}
+
 void RtdEngineImpl::CalcFirstVideoFrameDuration() {
+  MarkStartupPhase(&RtdStartupMetrics::first_video_frame_ms);
   int64_t now_ms = clock_->TimeInMilliseconds();
+  MutexLock lock(&metrics_mutex_);
   first_video_frame_duration_ = now_ms - start_open_time_ms_;
   RTC_LOG(LS_INFO) << "RtdEngineImpl::CalcFirstVideoFrameDuration() first_video_frame_duration:" << first_video_frame_duration_;
 }
 
 void RtdEngineImpl::CalcFirstAudioFrameDuration() {
+  MarkStartupPhase(&RtdStartupMetrics::first_audio_frame_ms);
   int64_t now_ms = clock_->TimeInMilliseconds();
+  MutexLock lock(&metrics_mutex_);
   first_audio_frame_duration_ = now_ms - start_open_time_ms_;
   RTC_LOG(LS_INFO) << "RtdEngineImpl::CalcFirstAudioFrameDuration() first_audio_frame_duration:" << first_audio_frame_duration_;
 }
@@ -366,17 +729,18 @@ int RtdEngineImpl::AudioDecoderInit(struct DecoderInitParam& init_param) {
   return -1;
 }
 
-int RtdEngineImpl::DecodeAudio(uint8_t* encoded, uint32_t encoded_len,
+int RtdEngineImpl::DecodeAudio(rtc::ArrayView<const uint8_t> encoded,
                                uint32_t sample_rate, uint32_t channels,
-                               int16_t* decoded) {
+                               rtc::ArrayView<int16_t> decoded) {
   if (conf_.callbacks.audio_decode) {
     RtdAudioDecodedInfo info;
-    info.encoded_data = encoded;
-    info.encoded_size = encoded_len;
+    info.encoded_data = encoded.data();
+    info.encoded_size = static_cast<int>(encoded.size());
     info.dst_channels = channels;
     info.dst_sample_rate = sample_rate;
+    info.dst_capacity = static_cast<int>(decoded.size());
 
-    int ret = conf_.callbacks.audio_decode(conf_.ff_ctx, &info, decoded);
+    int ret = conf_.callbacks.audio_decode(conf_.ff_ctx, &info, decoded.data());
     // RTC_LOG(LS_INFO) << "RtdEngineImpl::DecodeAudio call audio_decode ret:" << ret;
     return ret;
   }
@@ -392,18 +756,129 @@ int RtdEngineImpl::AudioDecoderUninit() {
   return 0;
 }
 
+void RtdEngineImpl::OnAudioDecoded(int64_t decode_us, bool ahead) {
+  MutexLock lock(&metrics_mutex_);
+  ++audio_decode_.decoded;
+  if (ahead) {
+    ++audio_decode_.decoded_ahead;
+  }
+  audio_decode_.total_us += decode_us;
+  audio_decode_.max_us = std::max(audio_decode_.max_us, decode_us);
+}
+
+void RtdEngineImpl::OnAudioDecodeLate() {
+  MutexLock lock(&metrics_mutex_);
+  ++audio_decode_.late;
+}
+
 void RtdEngineImpl::OnSdpOffer(std::string& sdp) {
   RTC_LOG(LS_INFO) << "RtcEngineImpl::OnSdpOffer() sdp:" << sdp;
   if (signaling_) {
-    std::string answer_sdp;
     int64_t now_ntp_ms = clock_->CurrentNtpInMilliseconds();
     std::string now_str = rtc::MD5(rtc::ToString(now_ntp_ms));
     RTC_LOG(LS_INFO) << "RtcEngineImpl::now_str:" << now_str;
-    signaling_->ConnectAndWaitResponse(sdp, &answer_sdp);
-    SetAnswer(answer_sdp);
+    // The answer comes back on the http thread, the signaling thread stays
+    // free meanwhile. Close() cancels both the request and the posted task.
+    rtc::scoped_refptr<PendingTaskSafetyFlag> safety = signaling_safety_;
+    MarkStartupPhase(&RtdStartupMetrics::signaling_sent_ms);
+    int ret = signaling_->Connect(sdp, [this, safety](int code, const std::string& answer_sdp,
+                                                      const RtdHttpTiming& timing) {
+      signaling_thread_->PostTask(ToQueuedTask(safety, [this, code, answer_sdp, timing] {
+        {
+          MutexLock lock(&metrics_mutex_);
+          startup_metrics_.http_dns_ms = timing.dns_ms;
+          startup_metrics_.http_connect_ms = timing.connect_ms;
+          startup_metrics_.http_tls_ms = timing.tls_ms;
+          startup_metrics_.http_first_byte_ms = timing.first_byte_ms;
+        }
+        OnSdpAnswer(code, answer_sdp);
+      }));
+    });
+    if (ret != 0) {
+      OnSdpAnswer(ret, "");
+    }
   }
 }
 
+void RtdEngineImpl::OnSdpAnswer(int code, const std::string& answer_sdp) {
+  RTC_LOG(LS_INFO) << "RtcEngineImpl::OnSdpAnswer() code:" << code;
+  MarkStartupPhase(&RtdStartupMetrics::answer_received_ms);
+  if (code != 200 || !SetAnswer(answer_sdp)) {
+    RTC_LOG(LS_ERROR) << "RtcEngineImpl::OnSdpAnswer() signaling failed.";
+    media_conn_status_ = RTD_MEDIA_CONN_FAILED;
+    return;
+  }
+  stale_media_deadline_ms_ = clock_->TimeInMilliseconds() + kRtdStaleMediaMaxMs;
+  switching_ = false;
+  if (!sender_report_poll_.Running()) {
+    sender_report_poll_ = RepeatingTaskHandle::Start(signaling_thread_, [this] {
+      PollSenderReports();
+      return TimeDelta::Millis(kRtdSenderReportPollMs);
+    });
+  }
+}
+
+void RtdEngineImpl::PollSenderReports() {
+  if (!peer_connection_) {
+    return;
+  }
+  cricket::VoiceMediaChannel* voice_channel = nullptr;
+  cricket::VideoMediaChannel* video_channel = nullptr;
+  FindMediaChannels(peer_connection_.get(), &voice_channel, &video_channel);
+
+  cricket::VoiceMediaInfo voice_info;
+  cricket::VideoMediaInfo video_info;
+  context_->worker_thread()->Invoke<void>(RTC_FROM_HERE, [&] {
+    if (voice_channel) {
+      voice_channel->GetStats(&voice_info, false);
+    }
+    if (video_channel) {
+      video_channel->GetStats(&video_info);
+    }
+  });
+
+  {
+    MutexLock lock(&metrics_mutex_);
+    FillReceiveStats(voice_info, video_info, receive_stats_);
+  }
+
+  // The NTP/RTP pairs the stream synchronizer uses, the packets themselves
+  // rarely carry capture times.
+  for (const cricket::VoiceReceiverInfo& audio : voice_info.receivers) {
+    if (audio.last_sender_report_rtp_timestamp && audio.last_sender_report_ntp_ms) {
+      media_clock_.OnSenderReport(kRtdClockAudio, audio.ssrc(), *audio.last_sender_report_rtp_timestamp,
+                                  *audio.last_sender_report_ntp_ms);
+    }
+  }
+  for (const cricket::VideoReceiverInfo& video : video_info.receivers) {
+    if (video.last_sender_report_rtp_timestamp && video.last_sender_report_ntp_ms) {
+      media_clock_.OnSenderReport(kRtdClockVideo, video.ssrc(), *video.last_sender_report_rtp_timestamp,
+                                  *video.last_sender_report_ntp_ms);
+    }
+  }
+}
+
+bool RtdEngineImpl::IsStaleMedia(int media, const RtpPacketInfos& packet_infos) {
+  uint32_t stale_ssrc = stale_ssrc_[media];
+  if (stale_ssrc == 0) {
+    return false;
+  }
+  // A frame without packet infos, e.g. NetEq expanding, is not known new.
+  // A sender keeping its ssrc across the switch runs into the deadline.
+  bool new_ssrc = !packet_infos.empty() && packet_infos.back().ssrc() != stale_ssrc;
+  if (new_ssrc || clock_->TimeInMilliseconds() >= stale_media_deadline_ms_) {
+    RTC_LOG(LS_INFO) << "RtdEngineImpl::IsStaleMedia() media:" << media << " old ssrc:" << stale_ssrc
+                     << " drained, new ssrc seen:" << new_ssrc;
+    stale_ssrc_[media] = 0;
+    return false;
+  }
+  return true;
+}
+
+void RtdEngineImpl::OnRemoteDescriptionSet() {
+  MarkStartupPhase(&RtdStartupMetrics::remote_description_set_ms);
+}
+
 // PeerConnectionObserver implementation
 void RtdEngineImpl::OnSignalingChange(PeerConnectionInterface::SignalingState new_state) {
   RTC_LOG(LS_INFO) << "RtcEngineImpl::OnSignalingChange() new_state:" << new_state;
@@ -421,12 +896,10 @@ void RtdEngineImpl::OnIceConnectionChange(PeerConnectionInterface::IceConnection
     media_conn_status_ = RTD_MEDIA_CONN_FAILED;
     break;
   case PeerConnectionInterface::kIceConnectionConnected:
+    MarkStartupPhase(&RtdStartupMetrics::ice_connected_ms);
     if (stream_info_parsed_) {
-      RtdDemuxInfo info;
-      info.audio_enabled = enable_audio_;
-      info.video_enabled = enable_video_;
-      info.audio_sample_rate = sample_rate_;
-      info.audio_channels = channels_;
+      RtdDemuxInfo info = { 0 };
+      FillStreamInfo(info);
       if (conf_.callbacks.media_info_callback) {
         conf_.callbacks.media_info_callback(conf_.ff_ctx, info);
       }
@@ -460,6 +933,11 @@ void RtdEngineImpl::OnIceConnectionReceivingChange(bool receiving) {
 
 void RtdEngineImpl::OnFirstPacketReceived(cricket::MediaType media_type) {
   RTC_LOG(LS_INFO) << "RtcEngineImpl::OnFirstPacketReceived type:" << media_type;
+  if (media_type == cricket::MEDIA_TYPE_AUDIO) {
+    MarkStartupPhase(&RtdStartupMetrics::first_audio_packet_ms);
+  } else if (media_type == cricket::MEDIA_TYPE_VIDEO) {
+    MarkStartupPhase(&RtdStartupMetrics::first_video_packet_ms);
+  }
 }
 
 // AudioFrameCallback implementation
@@ -467,6 +945,14 @@ int RtdEngineImpl::OnAudioFrame(AudioFrame* frame) {
   if (stream_stopped_) {
     return -1;
   }
+  if (switching_ || IsStaleMedia(kRtdClockAudio, frame->packet_infos_)) {
+    return 0;   // NetEq drains the old stream, nobody hears it
+  }
+  // Also in passthrough, the packet infos only come with the decoded audio.
+  media_clock_.OnPacketInfos(kRtdClockAudio, frame->packet_infos_);
+  if (audio_passthrough_) {
+    return 0;   // silence, frames went out in OnEncodedAudioFrame()
+  }
   if (!first_audio_frame_received_) {
     CalcFirstAudioFrameDuration();
     first_audio_frame_received_ = true;
@@ -477,8 +963,9 @@ int RtdEngineImpl::OnAudioFrame(AudioFrame* frame) {
   audio_frame.num_channels = frame->num_channels();
   audio_frame.samples_per_channel = frame->samples_per_channel();
   audio_frame.sample_rate_hz = frame->sample_rate_hz();
-  audio_frame.timestamp_ms = timestamp_wraparound_handler_.Unwrap(frame->timestamp_) / (frame->sample_rate_hz() / 1000);
-  audio_frame.timestamp_rtp = timestamp_wraparound_handler_.Unwrap(frame->timestamp_);
+  audio_frame.timestamp_rtp = media_clock_.Unwrap(kRtdClockAudio, frame->timestamp_);
+  audio_frame.timestamp_ms = media_clock_.ToMs(kRtdClockAudio, audio_frame.timestamp_rtp,
+                                               frame->sample_rate_hz() / 1000);
   audio_frame.codec_type = RtdAudioCodecType::RTD_OPUS;
   if (sink_) {
     sink_->OnAudioFrame(audio_frame);
@@ -487,9 +974,35 @@ int RtdEngineImpl::OnAudioFrame(AudioFrame* frame) {
   return 0;
 }
 
+void RtdEngineImpl::OnEncodedAudioFrame(const uint8_t* data, size_t size,
+                                        uint32_t timestamp, int duration_ms) {
+  // Delivered as NetEq inserts it, nothing of the old stream is buffered.
+  if (stream_stopped_ || switching_) {
+    return;
+  }
+  if (!first_audio_frame_received_) {
+    CalcFirstAudioFrameDuration();
+    first_audio_frame_received_ = true;
+  }
+
+  RtdEncodedAudioFrame audio_frame;
+  audio_frame.data = data;
+  audio_frame.size = size;
+  audio_frame.timestamp_rtp = media_clock_.Unwrap(kRtdClockAudio, timestamp);
+  audio_frame.timestamp_ms = media_clock_.ToMs(kRtdClockAudio, audio_frame.timestamp_rtp,
+                                               kRtdPassthroughClockKhz);
+  audio_frame.duration_ms = duration_ms;
+  if (sink_) {
+    sink_->OnEncodedAudioFrame(audio_frame);
+  }
+}
+
 // EncodedImageCallback implementation
 EncodedImageCallback::Result RtdEngineImpl::OnEncodedImage(const EncodedImage& encoded_image,
                                                            const CodecSpecificInfo* codec_specific_info) {
+  if (switching_ || IsStaleMedia(kRtdClockVideo, encoded_image.PacketInfos())) {
+    return EncodedImageCallback::Result(EncodedImageCallback::Result::OK, encoded_image.Timestamp());
+  }
   if (!first_video_frame_received_) {
     CalcFirstVideoFrameDuration();
     first_video_frame_received_ = true;
@@ -497,9 +1010,10 @@ EncodedImageCallback::Result RtdEngineImpl::OnEncodedImage(const EncodedImage& e
   auto result = EncodedImageCallback::Result(EncodedImageCallback::Result::OK, encoded_image.Timestamp());
 
   RtdVideoFrame frame;
-  frame.timestamp_ms = timestamp_wraparound_handler_.Unwrap(encoded_image.Timestamp()) / 90;
+  media_clock_.OnPacketInfos(kRtdClockVideo, encoded_image.PacketInfos());
+  frame.timestamp_rtp = media_clock_.Unwrap(kRtdClockVideo, encoded_image.Timestamp());
+  frame.timestamp_ms = media_clock_.ToMs(kRtdClockVideo, frame.timestamp_rtp, kRtdVideoClockKhz);
   frame.play_timestamp_ms = frame.timestamp_ms; // no bframe
-  frame.timestamp_rtp = timestamp_wraparound_handler_.Unwrap(encoded_image.Timestamp());
   frame.data = const_cast<uint8_t*>(encoded_image.data());
   frame.size = encoded_image.size();
   frame.codec_type = RtdVideoCodecType::RTD_H264;
@@ -509,6 +1023,13 @@ EncodedImageCallback::Result RtdEngineImpl::OnEncodedImage(const EncodedImage& e
     sink_->OnVideoFrame(frame);
   }
 
+  if (frame.frame_type == RtdFrameType::RTD_KEY_FRAME) {
+    if (!first_key_frame_received_) {
+      MarkStartupPhase(&RtdStartupMetrics::first_key_frame_ms);
+      first_key_frame_received_ = true;
+    }
+  }
+
   return result;
 }
 
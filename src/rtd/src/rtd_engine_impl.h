@@ -6,8 +6,12 @@
 #include "rtc_base/async_invoker.h"
 #include "rtc_base/event.h"
 #include "rtc_base/synchronization/mutex.h"
+#include "rtc_base/task_utils/pending_task_safety_flag.h"
+#include "rtc_base/task_utils/repeating_task.h"
 #include "rtc_base/time_utils.h"
+#include "rtd_engine_context.h"
 #include "rtd_engine_interface.h"
+#include "rtd_media_clock.h"
 #include "rtd_signaling.h"
 #include "rtd_audio_decoder_factory.h"
 #include "rtd_video_decoder_factory.h"
@@ -29,13 +33,27 @@ class RtdEngineImpl : public PeerConnectionObserver,
   virtual ~RtdEngineImpl();
 
   // RtdEngineInterface implementation
+  void SetAudioOutput(int output) override;
+  void SetThreadMode(int mode) override;
   int Open() override;
   void Close() override;
   bool SetAnswer(const std::string& answer_sdp) override;
   int GetStreamInfo(RtdDemuxInfo& info) override;
-
-  bool CreateOffer();
+  int GetAudioCodecInfo(RtdAudioCodecInfo& info) override;
+  void RequestKeyFrame() override;
+  int Switch(const std::string& url) override;
+  void GetStartupMetrics(RtdStartupMetrics& metrics) override;
+  int GetStats(RtdStats& stats) override;
+
+  // Builds the peer connection and its offer ahead of Open(), without a
+  // stream. Blocks until the offer is ready. See RtdEnginePool.
+  bool Prepare();
+  // Gives a prepared engine its stream, before Open().
+  void Attach(RtdSinkInterface* sink, const std::string& url, RtdConf conf);
+
+  bool CreateOffer(bool ice_restart = false);
   void SetLocalDescription(SessionDescriptionInterface* desc);
+  void OnRemoteDescriptionSet();
 
  protected:
   bool InitializePeerConnection();
@@ -46,13 +64,22 @@ class RtdEngineImpl : public PeerConnectionObserver,
   void SignalSyncEvent(bool success);
   void CalcFirstVideoFrameDuration();
   void CalcFirstAudioFrameDuration();
+  void ParseAudioCodec(const std::string& name, int clockrate_hz, size_t channels,
+                       const SdpAudioFormat::Parameters& params);
+  void FillStreamInfo(RtdDemuxInfo& info);
+  // Restarts the startup clock, all phases unreached.
+  void ResetStartupMetrics();
+  // Records |phase| once, in ms since the startup clock started. Any thread.
+  void MarkStartupPhase(int RtdStartupMetrics::*phase);
 
   // AudioDecoderSink implementation
   int AudioDecoderInit(struct DecoderInitParam& init_param) override;
-  int DecodeAudio(uint8_t* encoded, uint32_t encoded_len,
+  int DecodeAudio(rtc::ArrayView<const uint8_t> encoded,
                   uint32_t sample_rate, uint32_t channels,
-                  int16_t* decoded) override;
+                  rtc::ArrayView<int16_t> decoded) override;
   int AudioDecoderUninit() override;
+  void OnAudioDecoded(int64_t decode_us, bool ahead) override;
+  void OnAudioDecodeLate() override;
 
   // PeerConnectionObserver implementation
   void OnSignalingChange(PeerConnectionInterface::SignalingState new_state) override;
@@ -68,19 +95,32 @@ class RtdEngineImpl : public PeerConnectionObserver,
 
   // AudioFrameCallback implementation
   int OnAudioFrame(AudioFrame* frame) override;
+  void OnEncodedAudioFrame(const uint8_t* data, size_t size,
+                           uint32_t timestamp, int duration_ms) override;
 
   // EncodedImageCallback implementation
   Result OnEncodedImage(const EncodedImage& encoded_image,
                         const CodecSpecificInfo* codec_specific_info) override;
 
   void OnSdpOffer(std::string& sdp);
+  // Signaling thread, |code| is 200 on success.
+  void OnSdpAnswer(int code, const std::string& answer_sdp);
 
   void ParseStreamInfo(SessionDescriptionInterface* session_description);
 
  private:
-  std::unique_ptr<rtc::Thread> worker_thread_;
-  std::unique_ptr<rtc::Thread> network_thread_;
-  std::unique_ptr<rtc::Thread> signaling_thread_;
+  // Whether a frame of |media| with |packet_infos| is still of the stream
+  // before the last Switch(), see stale_ssrc_.
+  bool IsStaleMedia(int media, const RtpPacketInfos& packet_infos);
+  // Signaling thread. Hands the receivers' last RTCP sender reports to
+  // media_clock_ and snapshots their stats for GetStats().
+  void PollSenderReports();
+
+  // Declared first, the threads must outlive the peer connection.
+  std::shared_ptr<RtdEngineContext> context_;
+  std::unique_ptr<rtc::Thread> own_signaling_thread_;
+  rtc::Thread* signaling_thread_;   // own or the shared worker
+  int thread_mode_;
 
   rtc::scoped_refptr<PeerConnectionInterface> peer_connection_;
   rtc::scoped_refptr<PeerConnectionFactoryInterface> peer_connection_factory_;
@@ -90,21 +130,59 @@ class RtdEngineImpl : public PeerConnectionObserver,
   RtdSinkInterface* sink_;
   Clock* const clock_;
   //rtc::AsyncInvoker invoker_;
-  rtc::TimestampWrapAroundHandler timestamp_wraparound_handler_;
+  RtdMediaClock media_clock_;   // pts of both media
   std::unique_ptr<RtdSignaling> signaling_;
   bool stream_info_parsed_;
   bool enable_audio_;
   bool enable_video_;
   int sample_rate_;
   int channels_;
-  int64_t start_open_time_ms_;
+  bool audio_passthrough_;
+  int audio_codec_;
+  std::vector<uint8_t> audio_extradata_;
+  Mutex metrics_mutex_;
+  int64_t start_open_time_ms_ RTC_GUARDED_BY(metrics_mutex_);
+  RtdStartupMetrics startup_metrics_ RTC_GUARDED_BY(metrics_mutex_);
+  // AAC decode timing, from the decoder through AudioDecoderSink.
+  struct AudioDecodeCounters {
+    int64_t decoded = 0;
+    int64_t decoded_ahead = 0;
+    int64_t total_us = 0;
+    int64_t max_us = 0;
+    int64_t late = 0;
+  };
+  AudioDecodeCounters audio_decode_ RTC_GUARDED_BY(metrics_mutex_);
+  // Receive fields of RtdStats, refreshed by PollSenderReports().
+  RtdStats receive_stats_ RTC_GUARDED_BY(metrics_mutex_);
   int64_t first_video_frame_duration_;
   int64_t first_audio_frame_duration_;
   bool first_audio_frame_received_;
   bool first_video_frame_received_;
+  bool first_key_frame_received_;
   RtdMediaConnStatus media_conn_status_;
   bool stream_stopped_;
   bool is_stopped_;
+  // When RequestKeyFrame() last sent a PLI, on the signaling thread.
+  int64_t last_key_frame_request_ms_;
+  // Set by Prepare(): the offer is kept for Open() instead of being sent.
+  bool prepared_;
+  std::string prepared_offer_;
+  rtc::Event offer_ready_;
+  // Guards tasks posted to the signaling thread, cleared there in Close().
+  // Replaced by Switch(), so answers to an older offer are dropped.
+  rtc::scoped_refptr<PendingTaskSafetyFlag> signaling_safety_;
+  // As signaling_safety_ but kept across Switch(), for tasks of the engine
+  // rather than of one offer.
+  rtc::scoped_refptr<PendingTaskSafetyFlag> engine_safety_;
+  // From Switch() until the new answer is set, media is not delivered.
+  std::atomic<bool> switching_;
+  // NetEq and the frame buffer still hold media of the old stream when the
+  // answer comes. It is dropped by its ssrc, until the new ssrc shows up or
+  // for at most kRtdStaleMediaMaxMs after the answer. 0 once it did.
+  std::atomic<uint32_t> stale_ssrc_[kRtdClockMediaCount];
+  std::atomic<int64_t> stale_media_deadline_ms_;
+  // Runs PollSenderReports() from the first answer until Close().
+  RepeatingTaskHandle sender_report_poll_;
 };
 
 } // namespace rtd
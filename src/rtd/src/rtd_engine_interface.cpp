@@ -1,5 +1,7 @@
 #include "rtd_engine_interface.h"
 #include "rtd_engine_impl.h"
+#include "rtd_engine_pool.h"
+#include "rtd_signaling.h"
 
 namespace webrtc {
 namespace rtd {
@@ -11,6 +13,33 @@ std::unique_ptr<RtdEngineInterface> RtdEngineInterface::Create(
   return std::unique_ptr<RtdEngineInterface>(new RtdEngineImpl(sink, url, conf));
 }
 
+std::unique_ptr<RtdEngineInterface> RtdEngineInterface::CreatePrepared(
+    RtdSinkInterface* sink,
+    const std::string& url,
+    RtdConf conf,
+    int audio_output,
+    int thread_mode) {
+  // No pool before the first Prepare(), plain opens do not start one.
+  RtdEnginePool* pool = RtdEnginePool::GetIfCreated();
+  if (!pool) {
+    return nullptr;
+  }
+  std::unique_ptr<RtdEngineImpl> engine = pool->Take(audio_output, thread_mode);
+  if (engine) {
+    engine->Attach(sink, url, conf);
+  }
+  return std::unique_ptr<RtdEngineInterface>(engine.release());
+}
+
+void RtdEngineInterface::Prepare(int count, int audio_output, int thread_mode) {
+  if (count > 0) {
+    RtdSignaling::Prewarm();
+  } else if (!RtdEnginePool::GetIfCreated()) {
+    return;   // nothing prepared to release
+  }
+  RtdEnginePool::Get()->Prepare(count, audio_output, thread_mode);
+}
+
 
 } // namespace rtd
 } // namespace webrtc
\ No newline at end of file
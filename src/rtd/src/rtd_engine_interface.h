@@ -14,6 +14,8 @@ class RtdSinkInterface {
   virtual ~RtdSinkInterface() = default;
 
   virtual void OnAudioFrame(const RtdAudioFrame& frame) = 0;
+  // Called instead of OnAudioFrame() when audio output is encoded.
+  virtual void OnEncodedAudioFrame(const RtdEncodedAudioFrame& frame) = 0;
   virtual void OnVideoFrame(const RtdVideoFrame& frame) = 0;
 };
 
@@ -25,11 +27,41 @@ class RtdEngineInterface {
       RtdSinkInterface* sink,
       const std::string& url,
       RtdConf conf);
+  // An engine made ahead by Prepare() for |audio_output| and |thread_mode|,
+  // null if none is ready. Its Open() only runs signaling.
+  static std::unique_ptr<RtdEngineInterface> CreatePrepared(
+      RtdSinkInterface* sink,
+      const std::string& url,
+      RtdConf conf,
+      int audio_output,
+      int thread_mode);
+  // Keeps |count| engines ready for CreatePrepared(), see RtdEnginePool, and
+  // connects to the signaling server ahead.
+  static void Prepare(int count, int audio_output, int thread_mode);
 
+  // RtdAudioOutput, takes effect at Open().
+  virtual void SetAudioOutput(int output) = 0;
+  // RtdThreadMode, takes effect at Open().
+  virtual void SetThreadMode(int mode) = 0;
   virtual int Open() = 0;
   virtual void Close() = 0;
   virtual bool SetAnswer(const std::string& answer_sdp) = 0;
   virtual int GetStreamInfo(RtdDemuxInfo& info) = 0;
+  // Codec of the audio frames delivered. Returns 0, or -1 before the stream
+  // info is known.
+  virtual int GetAudioCodecInfo(RtdAudioCodecInfo& info) = 0;
+  // Asks the sender for a key frame (PLI). Rate limited, any thread.
+  virtual void RequestKeyFrame() = 0;
+  // Moves an open engine to another stream, keeping the peer connection:
+  // renegotiates with an ICE restart through signaling for |url|. No frames
+  // are delivered until the new answer is applied. Returns -1 if not open.
+  virtual int Switch(const std::string& url) = 0;
+  // Phases of the last Open() or Switch() reached so far. The read_ fields
+  // are left to the caller. Any thread.
+  virtual void GetStartupMetrics(RtdStartupMetrics& metrics) = 0;
+  // Fills the rtp, NetEq and jitter buffer fields of |stats| from the media
+  // channels. Returns 0, or -1 before the peer connection exists.
+  virtual int GetStats(RtdStats& stats) = 0;
 };
 
 } // namespace rtd
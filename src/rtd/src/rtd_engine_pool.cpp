@@ -0,0 +1,164 @@
+#include "rtd_engine_pool.h"
+#include <algorithm>
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+
+namespace webrtc {
+namespace rtd {
+
+namespace {
+
+// Candidates gathered for the offer outlive NAT bindings after about this
+// long, and the server may reject an offer that old.
+constexpr int64_t kRtdPreparedEngineMaxAgeMs = 30000;
+
+} // namespace
+
+std::atomic<RtdEnginePool*> RtdEnginePool::created_(nullptr);
+
+RtdEnginePool* RtdEnginePool::Get() {
+  // Never destroyed, prepared engines may be held until the process exits.
+  static RtdEnginePool* const pool = [] {
+    RtdEnginePool* pool = new RtdEnginePool();
+    created_.store(pool, std::memory_order_release);
+    return pool;
+  }();
+  return pool;
+}
+
+RtdEnginePool* RtdEnginePool::GetIfCreated() {
+  return created_.load(std::memory_order_acquire);
+}
+
+RtdEnginePool::RtdEnginePool()
+    : thread_(rtc::Thread::Create()),
+      expiry_refill_posted_(false),
+      count_(0),
+      audio_output_(RTD_AUDIO_OUTPUT_PCM),
+      thread_mode_(RTD_THREAD_OWN_SIGNALING) {
+  RTC_LOG(LS_INFO) << "RtdEnginePool::RtdEnginePool().";
+  thread_->SetName("Prepare Thread", nullptr);
+  if (!thread_->Start()) {
+    RTC_LOG(LS_ERROR) << "prepare thread start failed.";
+  }
+}
+
+void RtdEnginePool::Prepare(size_t count, int audio_output, int thread_mode) {
+  RTC_LOG(LS_INFO) << "RtdEnginePool::Prepare() count:" << count << " audio_output:" << audio_output
+                   << " thread_mode:" << thread_mode;
+  {
+    MutexLock lock(&mutex_);
+    if (audio_output != audio_output_ || thread_mode != thread_mode_) {
+      for (auto& prepared : engines_) {
+        released_.push_back(std::move(prepared.engine));
+      }
+      engines_.clear();
+    }
+    while (engines_.size() > count) {
+      released_.push_back(std::move(engines_.back().engine));
+      engines_.pop_back();
+    }
+    count_ = count;
+    audio_output_ = audio_output;
+    thread_mode_ = thread_mode;
+  }
+  thread_->PostTask([this] { Refill(); });
+}
+
+std::unique_ptr<RtdEngineImpl> RtdEnginePool::Take(int audio_output, int thread_mode) {
+  std::unique_ptr<RtdEngineImpl> engine;
+  {
+    MutexLock lock(&mutex_);
+    ReleaseExpired(rtc::TimeMillis());
+    if (engines_.empty() || audio_output != audio_output_ || thread_mode != thread_mode_) {
+      return nullptr;
+    }
+    // The newest, its candidates are the freshest.
+    engine = std::move(engines_.back().engine);
+    engines_.pop_back();
+  }
+  RTC_LOG(LS_INFO) << "RtdEnginePool::Take() engine:" << engine.get();
+  thread_->PostTask([this] { Refill(); });
+  return engine;
+}
+
+int64_t RtdEnginePool::ReleaseExpired(int64_t now_ms) {
+  int64_t next_expiry_ms = -1;
+  for (auto it = engines_.begin(); it != engines_.end();) {
+    int64_t expiry_ms = it->prepared_ms + kRtdPreparedEngineMaxAgeMs;
+    if (expiry_ms <= now_ms) {
+      RTC_LOG(LS_INFO) << "RtdEnginePool::ReleaseExpired() engine:" << it->engine.get();
+      released_.push_back(std::move(it->engine));
+      it = engines_.erase(it);
+      continue;
+    }
+    if (next_expiry_ms < 0 || expiry_ms < next_expiry_ms) {
+      next_expiry_ms = expiry_ms;
+    }
+    ++it;
+  }
+  return next_expiry_ms;
+}
+
+void RtdEnginePool::Refill() {
+  while (true) {
+    std::vector<std::unique_ptr<RtdEngineImpl>> released;
+    int audio_output = RTD_AUDIO_OUTPUT_PCM;
+    int thread_mode = RTD_THREAD_OWN_SIGNALING;
+    int64_t next_expiry_ms = -1;
+    {
+      MutexLock lock(&mutex_);
+      next_expiry_ms = ReleaseExpired(rtc::TimeMillis());
+      released.swap(released_);
+      audio_output = audio_output_;
+      thread_mode = thread_mode_;
+    }
+
+    if (!released.empty()) {
+      for (auto& engine : released) {
+        engine->Close();
+      }
+      continue;
+    }
+
+    bool full = false;
+    {
+      MutexLock lock(&mutex_);
+      full = engines_.size() >= count_;
+    }
+    if (full) {
+      if (next_expiry_ms >= 0 && !expiry_refill_posted_) {
+        expiry_refill_posted_ = true;
+        int64_t delay_ms = std::max<int64_t>(next_expiry_ms - rtc::TimeMillis(), 0);
+        thread_->PostDelayedTask(
+            [this] {
+              expiry_refill_posted_ = false;
+              Refill();
+            },
+            static_cast<uint32_t>(delay_ms));
+      }
+      return;
+    }
+
+    std::unique_ptr<RtdEngineImpl> engine(new RtdEngineImpl(nullptr, "", RtdConf()));
+    engine->SetAudioOutput(audio_output);
+    engine->SetThreadMode(thread_mode);
+    if (!engine->Prepare()) {
+      // Opens build their own engine, retried on the next Prepare() or Take().
+      RTC_LOG(LS_ERROR) << "RtdEnginePool::Refill() prepare failed.";
+      engine->Close();
+      return;
+    }
+
+    MutexLock lock(&mutex_);
+    if (audio_output == audio_output_ && thread_mode == thread_mode_ && engines_.size() < count_) {
+      engines_.push_back({std::move(engine), rtc::TimeMillis()});
+    } else {
+      // Settings changed while preparing.
+      released_.push_back(std::move(engine));
+    }
+  }
+}
+
+} // namespace rtd
+} // namespace webrtc
@@ -0,0 +1,75 @@
+#ifndef RTD_ENGINE_POOL_H_
+#define RTD_ENGINE_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "rtc_base/synchronization/mutex.h"
+#include "rtc_base/thread.h"
+#include "rtc_base/thread_annotations.h"
+#include "rtd_engine_impl.h"
+
+namespace webrtc {
+namespace rtd {
+
+// Engines whose peer connection, transceivers and offer are built ahead of
+// open, which then only runs signaling and ICE. None of that depends on the
+// url. Engines are prepared for one audio output and thread mode, opens with
+// other settings build their own.
+//
+// Engines are prepared on the pool's own thread; one taken by an open is
+// replaced right away. An engine's offer, ICE credentials and candidates go
+// stale, so engines older than kRtdPreparedEngineMaxAgeMs are rebuilt.
+// Thread safe, created by the first Get() and kept for the life of the
+// process.
+class RtdEnginePool {
+ public:
+  static RtdEnginePool* Get();
+  // The pool if Get() made it already, else null. Never creates it.
+  static RtdEnginePool* GetIfCreated();
+
+  // Keeps |count| engines ready for |audio_output| (RtdAudioOutput) and
+  // |thread_mode| (RtdThreadMode). Engines prepared for other settings, or
+  // beyond |count|, are released. Returns at once.
+  void Prepare(size_t count, int audio_output, int thread_mode);
+
+  // A ready engine prepared for the given settings and not too old, null if
+  // there is none.
+  std::unique_ptr<RtdEngineImpl> Take(int audio_output, int thread_mode);
+
+ private:
+  struct PreparedEngine {
+    std::unique_ptr<RtdEngineImpl> engine;
+    int64_t prepared_ms;
+  };
+
+  RtdEnginePool();
+
+  // Releases the engines past their age. Returns when the next one expires,
+  // -1 if none is left.
+  int64_t ReleaseExpired(int64_t now_ms) RTC_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Tops the pool up to |count_|, closes released engines and has itself run
+  // again when the oldest engine expires. On |thread_|.
+  void Refill();
+
+  static std::atomic<RtdEnginePool*> created_;
+
+  std::unique_ptr<rtc::Thread> thread_;
+  // A delayed Refill() is posted for the next expiry. On |thread_|.
+  bool expiry_refill_posted_;
+  Mutex mutex_;
+  size_t count_ RTC_GUARDED_BY(mutex_);
+  int audio_output_ RTC_GUARDED_BY(mutex_);
+  int thread_mode_ RTC_GUARDED_BY(mutex_);
+  std::vector<PreparedEngine> engines_ RTC_GUARDED_BY(mutex_);
+  // Released by Prepare(), closed by Refill() off the caller's thread.
+  std::vector<std::unique_ptr<RtdEngineImpl>> released_ RTC_GUARDED_BY(mutex_);
+};
+
+} // namespace rtd
+} // namespace webrtc
+
+#endif // !RTD_ENGINE_POOL_H_
@@ -1,85 +1,336 @@
 #include "rtd_frame_queue.h"
+#include <string.h>
 #include "rtc_base/logging.h"
 
+namespace {
+
+// Buffers the reader may hold between ReadFront() and FreeBuffer(), as a
+// multiple of the queue capacity. Frames handed to FFmpeg without copying stay
+// out until the player drops the packet.
+constexpr size_t kRtdInFlightFactor = 1;
+
+// Ring size as a multiple of the queue capacity, the headroom holds entries
+// dropped by the producer until the reader skips them.
+constexpr size_t kRtdDropHeadroomFactor = 2;
+
+} // namespace
+
 namespace webrtc {
 namespace rtd {
 
-RtdFrameQueue::RtdFrameQueue(size_t capacity, size_t default_size)
-    : capacity_(capacity), default_size_(default_size) {
+RtdFrameQueue::RtdFrameQueue(size_t capacity, size_t min_buffer_size)
+    : capacity_(capacity),
+      pool_(min_buffer_size),
+      queue_(capacity * kRtdDropHeadroomFactor),
+      free_list_(capacity * kRtdDropHeadroomFactor + capacity * kRtdInFlightFactor),
+      ref_count_(0),
+      taken_count_(0),
+      freed_count_(0),
+      orphaned_(false),
+      flush_position_(0),
+      dropped_count_(0),
+      dropped_frames_(0) {
   RTC_LOG(LS_INFO) << "RtdFrameQueue::RtdFrameQueue().";
+  slots_.reserve(free_list_.capacity());
+  reuse_stack_.reserve(free_list_.capacity());
+  for (size_t i = 0; i < free_list_.capacity(); ++i) {
+    slots_.emplace_back(new RtdFrameBuffer());
+    slots_.back()->queue = this;
+    slots_.back()->frame.opaque = slots_.back().get();
+    reuse_stack_.push_back(slots_.back().get());
+  }
 }
 
 RtdFrameQueue::~RtdFrameQueue() {
   RTC_LOG(LS_INFO) << "RtdFrameQueue::~RtdFrameQueue().";
-  MutexLock lock(&mutex_);
+}
+
+rtc::scoped_refptr<RtdFrameQueue> RtdFrameQueue::Create(size_t capacity, size_t min_buffer_size) {
+  return rtc::scoped_refptr<RtdFrameQueue>(new RtdFrameQueue(capacity, min_buffer_size));
+}
+
+void RtdFrameQueue::AddRef() const {
+  ref_count_.fetch_add(1, std::memory_order_relaxed);
+}
 
-  for (RtdFrameBuffer* buffer : queue_) {
-    delete buffer;
+rtc::RefCountReleaseStatus RtdFrameQueue::Release() const {
+  if (ref_count_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+    return rtc::RefCountReleaseStatus::kOtherRefsRemained;
   }
-  for (RtdFrameBuffer* buffer : free_list_) {
-    delete buffer;
+  {
+    // The owner is done reading, |taken_count_| is final.
+    MutexLock lock(&free_mutex_);
+    if (freed_count_ != taken_count_) {
+      orphaned_ = true;   // the last FreeBuffers() deletes it
+      return rtc::RefCountReleaseStatus::kDroppedLastRef;
+    }
   }
+  delete this;
+  return rtc::RefCountReleaseStatus::kDroppedLastRef;
 }
 
 size_t RtdFrameQueue::Size() {
-  MutexLock lock(&mutex_);
-  return queue_.size();
+  uint64_t read_position = HeadPosition();
+  uint64_t write_position = queue_.WritePosition();
+  int64_t size = write_position > read_position ? static_cast<int64_t>(write_position - read_position) : 0;
+  size -= dropped_count_.load(std::memory_order_acquire);
+  return size > 0 ? static_cast<size_t>(size) : 0;
+}
+
+uint64_t RtdFrameQueue::HeadPosition() {
+  uint64_t read_position = queue_.ReadPosition();
+  uint64_t flush_position = flush_position_.load(std::memory_order_acquire);
+  return flush_position > read_position ? flush_position : read_position;
 }
 
 void RtdFrameQueue::Clear() {
-  MutexLock lock(&mutex_);
-  while (!queue_.empty()) {
-    free_list_.push_back(queue_.front());
-    queue_.pop_front();
+  uint64_t tail = queue_.WritePosition();
+  UncountDropped(HeadPosition(), tail);
+  flush_position_.store(tail, std::memory_order_release);
+}
+
+void RtdFrameQueue::UncountDropped(uint64_t begin, uint64_t end) {
+  uint64_t flushed = 0;
+  for (uint64_t position = begin; position < end; ++position) {
+    int state = kRtdBufferDropped;
+    if (queue_.At(position)->state.compare_exchange_strong(state, kRtdBufferTaken)) {
+      dropped_count_.fetch_sub(1, std::memory_order_acq_rel);
+    } else if (state == kRtdBufferQueued) {
+      ++flushed;   // the reader may still take it first, close enough for stats
+    }
+  }
+  dropped_frames_.fetch_add(flushed, std::memory_order_relaxed);
+}
+
+int64_t RtdFrameQueue::BufferedMs() {
+  uint64_t head = HeadPosition();
+  uint64_t tail = queue_.WritePosition();
+  if (head >= tail) {
+    return 0;
   }
+  return static_cast<int64_t>(queue_.At(tail - 1)->pts - queue_.At(head)->pts);
+}
+
+int64_t RtdFrameQueue::DropOldest(int64_t ms, bool key_frame_only) {
+  uint64_t head = HeadPosition();
+  uint64_t tail = queue_.WritePosition();
+  if (head >= tail) {
+    return 0;
+  }
+
+  // Popped entries keep their pts until the producer reuses them, so a
+  // consumer racing ahead only makes this drop less.
+  uint64_t first_pts = queue_.At(head)->pts;
+  for (uint64_t position = head; position < tail; ++position) {
+    const RtdFrameBuffer* packet = queue_.At(position);
+    if (static_cast<int64_t>(packet->pts - first_pts) >= ms &&
+        (!key_frame_only || (packet->flag & kRtdFrameKey))) {
+      UncountDropped(head, position);
+      flush_position_.store(position, std::memory_order_release);
+      return static_cast<int64_t>(packet->pts - first_pts);
+    }
+  }
+
+  Clear();
+  return -1;
+}
+
+int64_t RtdFrameQueue::DropBefore(uint64_t pts) {
+  uint64_t head = HeadPosition();
+  uint64_t tail = queue_.WritePosition();
+  if (head >= tail) {
+    return 0;
+  }
+
+  uint64_t first_pts = queue_.At(head)->pts;
+  for (uint64_t position = head; position < tail; ++position) {
+    const RtdFrameBuffer* packet = queue_.At(position);
+    if (packet->pts >= pts) {
+      if (position == head) {
+        return 0;
+      }
+      UncountDropped(head, position);
+      flush_position_.store(position, std::memory_order_release);
+      return static_cast<int64_t>(packet->pts - first_pts);
+    }
+  }
+
+  int64_t dropped_ms = static_cast<int64_t>(queue_.At(tail - 1)->pts - first_pts);
+  Clear();
+  return dropped_ms;
 }
 
 bool RtdFrameQueue::ReadFront(RtdFrameBuffer*& buffer) {
-  MutexLock lock(&mutex_);
-  if (queue_.empty()) {
+  RtdFrameBuffer* packet = nullptr;
+  while (PeekValid(packet)) {
+    queue_.Pop(packet);
+    int state = kRtdBufferQueued;
+    if (!packet->state.compare_exchange_strong(state, kRtdBufferTaken)) {
+      // Dropped after PeekValid() looked at it.
+      Recycle(packet);
+      continue;
+    }
+    ++taken_count_;
+    buffer = packet;
+    return true;
+  }
+
+  return false;
+}
+
+bool RtdFrameQueue::PeekFront(uint64_t& dts) {
+  RtdFrameBuffer* packet = nullptr;
+  if (!PeekValid(packet)) {
     return false;
   }
 
-  RtdFrameBuffer* packet = queue_.front();
-  queue_.pop_front();
-  buffer = packet;
+  dts = packet->dts;
+  return true;
+}
+
+bool RtdFrameQueue::PeekValid(RtdFrameBuffer*& buffer) {
+  uint64_t flush_position = flush_position_.load(std::memory_order_acquire);
+  RtdFrameBuffer* packet = nullptr;
+  uint64_t position = 0;
+  while (queue_.Peek(packet, &position)) {
+    if (position >= flush_position &&
+        packet->state.load(std::memory_order_acquire) != kRtdBufferDropped) {
+      buffer = packet;
+      return true;
+    }
+    // Flushed or dropped by the producer, recycle it.
+    queue_.Pop(packet);
+    Recycle(packet);
+  }
+
+  return false;
+}
 
+void RtdFrameQueue::Recycle(RtdFrameBuffer* buffer) {
+  // The producer may uncount it at the same time, whoever swaps the state
+  // does.
+  int state = kRtdBufferDropped;
+  if (buffer->state.compare_exchange_strong(state, kRtdBufferTaken)) {
+    dropped_count_.fetch_sub(1, std::memory_order_acq_rel);
+  }
+  MutexLock lock(&free_mutex_);
+  free_list_.Push(buffer);
+}
+
+bool RtdFrameQueue::MarkDropped(RtdFrameBuffer* buffer) {
+  int state = kRtdBufferQueued;
+  if (!buffer->state.compare_exchange_strong(state, kRtdBufferDropped)) {
+    return false;
+  }
+  dropped_count_.fetch_add(1, std::memory_order_acq_rel);
+  dropped_frames_.fetch_add(1, std::memory_order_relaxed);
   return true;
 }
 
+size_t RtdFrameQueue::DropDisposable(size_t count) {
+  size_t dropped = 0;
+  uint64_t tail = queue_.WritePosition();
+  for (uint64_t position = HeadPosition(); position < tail && dropped < count; ++position) {
+    RtdFrameBuffer* packet = queue_.At(position);
+    if ((packet->flag & kRtdFrameDisposable) && MarkDropped(packet)) {
+      ++dropped;
+    }
+  }
+  return dropped;
+}
+
+size_t RtdFrameQueue::DropGopTails(size_t count) {
+  size_t dropped = 0;
+  uint64_t gop_start = HeadPosition();
+  uint64_t tail = queue_.WritePosition();
+  for (uint64_t position = gop_start + 1; position < tail && dropped < count; ++position) {
+    if (!(queue_.At(position)->flag & kRtdFrameKey)) {
+      continue;
+    }
+    // [gop_start, position) is followed by a key frame, drop backwards from
+    // its end, keeping its first frame.
+    for (uint64_t end = position - 1; end > gop_start && dropped < count; --end) {
+      if (MarkDropped(queue_.At(end))) {
+        ++dropped;
+      }
+    }
+    gop_start = position;
+  }
+  return dropped;
+}
+
 void RtdFrameQueue::FreeBuffer(RtdFrameBuffer* buffer) {
-    MutexLock lock(&mutex_);
-    free_list_.push_back(buffer);
+  FreeBuffers(&buffer, 1);
+}
+
+void RtdFrameQueue::FreeBuffers(RtdFrameBuffer* const* buffers, size_t count) {
+  bool last_out = false;
+  {
+    MutexLock lock(&free_mutex_);
+    size_t freed = 0;
+    for (; freed < count; ++freed) {
+      if (!free_list_.Push(buffers[freed])) {
+        RTC_LOG(LS_ERROR) << "RtdFrameQueue::FreeBuffers free list is full, buffer freed twice?";
+        break;
+      }
+    }
+    freed_count_ += freed;
+    last_out = orphaned_ && freed_count_ == taken_count_;
+  }
+  if (last_out) {
+    delete this;
+  }
+}
+
+bool RtdFrameQueue::PopFreeSlot(RtdFrameBuffer*& buffer) {
+  // |free_list_| hands slots back oldest first; reusing in that order would
+  // cycle through every slot's buffer and miss the cache on each write.
+  RtdFrameBuffer* freed = nullptr;
+  while (free_list_.Pop(freed)) {
+    reuse_stack_.push_back(freed);
+  }
+  if (reuse_stack_.empty()) {
+    return false;
+  }
+  buffer = reuse_stack_.back();
+  reuse_stack_.pop_back();
+  return true;
 }
 
 bool RtdFrameQueue::WriteBack(const void* data, size_t bytes,
-                              uint64_t pts, uint64_t dts, 
+                              uint64_t pts, uint64_t dts,
                               int duration, int flag) {
-  MutexLock lock(&mutex_);
-  if (queue_.size() == capacity_) {
+  // Entries flushed by Clear() but not yet recycled by the reader still
+  // occupy the ring, so check the ring rather than Size().
+  if (queue_.WritePosition() - queue_.ReadPosition() >= queue_.capacity() ||
+      Size() >= capacity_) {
     return false;
   }
 
   RtdFrameBuffer* packet;
-  if (!free_list_.empty()) {
-    packet = free_list_.back();
-    free_list_.pop_back();
-    if (packet->buffer->capacity() < bytes) {
-      RTC_LOG(LS_INFO) << "Current available buffer size is smaller than frame data size, recreate one.";
-      delete packet->buffer;
-      packet->buffer = new rtc::Buffer(bytes, default_size_);
-    }
-  } else {
-    packet = new RtdFrameBuffer();
-    packet->buffer = new rtc::Buffer(bytes, default_size_);
+  if (!PopFreeSlot(packet)) {
+    // Every slot is either queued or still held by the reader.
+    return false;
+  }
+
+  // Swap the slot's buffer for one of the right size class, so a slot that
+  // once carried a key frame does not pin a key-frame-sized buffer.
+  size_t padded_bytes = bytes + RTD_FRAME_PADDING_SIZE;
+  if (!pool_.Fits(packet->buffer, padded_bytes)) {
+    pool_.Release(packet->buffer);
+    packet->buffer = pool_.Acquire(padded_bytes);
   }
 
-  packet->buffer->SetData(static_cast<const uint8_t*>(data), bytes);
+  packet->buffer->SetSize(padded_bytes);
+  memcpy(packet->buffer->data(), data, bytes);
+  memset(packet->buffer->data() + bytes, 0, RTD_FRAME_PADDING_SIZE);
+  packet->size = bytes;
   packet->pts = pts;
   packet->dts = dts;
   packet->duration = duration;
   packet->flag = flag;
-  queue_.push_back(packet);
+  packet->state.store(kRtdBufferQueued, std::memory_order_relaxed);
+  queue_.Push(packet);
 
   return true;
 }
@@ -2,50 +2,195 @@
 #define RTD_FRAME_QUEUE_H_
 
 #include <stddef.h>
-#include <deque>
+#include <atomic>
+#include <memory>
 #include <vector>
 
+#include "api/scoped_refptr.h"
 #include "rtc_base/buffer.h"
+#include "rtc_base/ref_count.h"
 #include "rtc_base/synchronization/mutex.h"
 #include "rtc_base/thread_annotations.h"
+#include "rtd_buffer_pool.h"
+#include "rtd_def.h"
 
 namespace webrtc {
 namespace rtd {
 
+constexpr size_t kRtdCacheLineSize = 64;
+
+// RtdFrameBuffer::flag bits. The reader gets those of RtdFrame::flag:
+// kRtdFrameKey and kRtdFrameDiscontinuity.
+constexpr int kRtdFrameKey = 0x01;
+constexpr int kRtdFrameDiscontinuity = 0x02;  // first frame after a switch
+constexpr int kRtdFrameDisposable = 0x04;     // no other frame refers to it
+
+enum RtdBufferState {
+  kRtdBufferQueued = 0,
+  kRtdBufferTaken,        // returned by ReadFront()
+  kRtdBufferDropped,      // dropped by the producer, skipped by the reader
+};
+
+class RtdFrameQueue;
+
 struct RtdFrameBuffer {
-  rtc::Buffer* buffer;
+  rtc::Buffer* buffer;    // frame data followed by RTD_FRAME_PADDING_SIZE zeros
+  size_t size;            // frame data size in bytes
   uint64_t pts;           // presentation timestamp, in ms
   uint64_t dts;           // decoding timestamp, in ms
-  int flag;               // for video frame
-                          //     bit 0: key frame;
+  int flag;               // kRtdFrame* bits
   int duration;           // in ms
+  std::atomic<int> state; // RtdBufferState, while in the ring
+
+  RtdFrame frame;         // view handed to the reader, frame.opaque points here
+  RtdFrameQueue* queue;   // queue the slot belongs to
 
-  RtdFrameBuffer() { buffer = nullptr; }
+  RtdFrameBuffer() : buffer(nullptr), size(0), state(kRtdBufferQueued), frame(), queue(nullptr) {}
   ~RtdFrameBuffer() {
     delete buffer;
   }
 };
 
-class RtdFrameQueue {
+// Bounded single-producer/single-consumer ring. Push() must only be called
+// from one thread and Pop() from one (other) thread. Positions are monotonic
+// counters, so the caller can tell which element was written first.
+template <typename T>
+class RtdSpscRing {
  public:
-  // Creates a buffer queue with a given capacity and default buffer size.
-  RtdFrameQueue(size_t capacity, size_t default_size);
-  virtual ~RtdFrameQueue();
+  explicit RtdSpscRing(size_t capacity)
+      : capacity_(capacity), slots_(capacity), head_(0), tail_(0) {}
+
+  size_t capacity() const { return capacity_; }
+
+  // Returns false if the ring is full.
+  bool Push(T item) {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) >= capacity_) {
+      return false;
+    }
+    slots_[tail % capacity_] = item;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Returns false if the ring is empty. |position| receives the write
+  // position of the popped element if not null.
+  bool Pop(T& item, uint64_t* position = nullptr) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = slots_[head % capacity_];
+    if (position) {
+      *position = head;
+    }
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Like Pop(), but leaves the element in the ring. Consumer side.
+  bool Peek(T& item, uint64_t* position = nullptr) const {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = slots_[head % capacity_];
+    if (position) {
+      *position = head;
+    }
+    return true;
+  }
+
+  // Element at |position|, which must have been pushed. Producer side: the
+  // slot is only rewritten by the producer's next Push() onto it.
+  const T& At(uint64_t position) const { return slots_[position % capacity_]; }
 
-  // Return number of queued buffers.
+  uint64_t ReadPosition() const { return head_.load(std::memory_order_acquire); }
+  uint64_t WritePosition() const { return tail_.load(std::memory_order_acquire); }
+
+ private:
+  const size_t capacity_;
+  std::vector<T> slots_;
+  // Keep the consumer and producer counters on separate cache lines. Plain
+  // padding instead of alignas(), the ring is heap allocated under C++14.
+  char head_padding_[kRtdCacheLineSize];
+  std::atomic<uint64_t> head_;
+  char tail_padding_[kRtdCacheLineSize - sizeof(std::atomic<uint64_t>)];
+  std::atomic<uint64_t> tail_;
+};
+
+// Frame queue between one producer (WebRTC decode/audio thread) and one
+// consumer (the player's read thread). All slots are allocated up front and
+// cycle between |queue_| and |free_list_|, so neither side takes a lock or
+// allocates on the hot path. The producer reuses the most recently freed slot
+// first, whose buffer is still in cache.
+//
+// Only the consumer pops. The producer drops queued entries by moving the
+// flush position or by marking them, the consumer recycles them as it goes;
+// the ring is larger than |capacity_| so marked entries leave room to write.
+//
+// Buffers handed out by ReadFront() may be held as long as the reader likes
+// and freed from any thread. The queue counts its own references instead of
+// taking one per buffer: when the last reference goes with buffers still out,
+// the last FreeBuffers() deletes it.
+class RtdFrameQueue : public rtc::RefCountInterface {
+ public:
+  // Creates a buffer queue with a given capacity. Frame buffers come from a
+  // size-class pool whose smallest class is |min_buffer_size|.
+  static rtc::scoped_refptr<RtdFrameQueue> Create(size_t capacity, size_t min_buffer_size);
+
+  void AddRef() const override;
+  rtc::RefCountReleaseStatus Release() const override;
+
+  // Return number of queued buffers. May be called from either side, the
+  // result is a snapshot.
   size_t Size();
 
-  // Clear the BufferQueue by moving all Buffers from |queue_| to |free_list_|.
+  // Discard all queued buffers. Called by the producer; the discarded buffers
+  // are returned to the free list by the consumer on its next ReadFront().
   void Clear();
 
-  // ReadFront will only read one buffer at a time
+  // ReadFront will only read one buffer at a time. Consumer side.
   // Returns true unless no data could be returned.
   bool ReadFront(RtdFrameBuffer* & buffer);
 
-  // Return current buffer to free list
+  // Producer side. Media buffered in ms: pts of the newest queued buffer
+  // minus pts of the oldest.
+  int64_t BufferedMs();
+
+  // Producer side. Drops queued buffers from the oldest on, up to the first
+  // one |ms| or more after it (by pts) that is a key frame when
+  // |key_frame_only|. Returns the ms dropped, or -1 if no buffer qualified
+  // and the queue was cleared.
+  int64_t DropOldest(int64_t ms, bool key_frame_only);
+
+  // Producer side. Drops queued buffers with a pts before |pts|. Returns the
+  // ms dropped.
+  int64_t DropBefore(uint64_t pts);
+
+  // Producer side. Drops up to |count| queued frames flagged
+  // kRtdFrameDisposable, oldest first. Returns the number dropped.
+  size_t DropDisposable(size_t count);
+
+  // Producer side. Drops up to |count| frames from the ends of queued GOPs,
+  // i.e. runs of frames right before a queued key frame, oldest GOP first.
+  // The frames kept still decode. Returns the number dropped.
+  size_t DropGopTails(size_t count);
+
+  // Reads the dts of the buffer ReadFront() would return next, without
+  // removing it. Consumer side.
+  // Returns false if the queue is empty.
+  bool PeekFront(uint64_t& dts);
+
+  // Return a buffer obtained from ReadFront() to the free list. Any thread.
+  // Deletes the queue if it was the last one out and the queue has no
+  // reference left.
   void FreeBuffer(RtdFrameBuffer* buffer);
+  // Same as FreeBuffer() for |count| buffers of this queue, locking once.
+  void FreeBuffers(RtdFrameBuffer* const* buffers, size_t count);
 
   // WriteBack always writes either the complete memory or nothing.
+  // Producer side.
   // pts: presentation time stamp, in ms
   // dts: decoding time stamp, in ms
   // duration: frame duration in ms
@@ -53,12 +198,56 @@ class RtdFrameQueue {
   // Returns true unless no data could be written.
   bool WriteBack(const void* data, size_t bytes, uint64_t pts, uint64_t dts, int duration, int flag = 0);
 
+  // Bytes of frame memory held by the queue, queued or cached.
+  size_t AllocatedBytes() const { return pool_.AllocatedBytes(); }
+
+  // Frames dropped by Clear() and the Drop*() calls so far, before the reader
+  // got them. Any thread.
+  uint64_t DroppedFrames() const { return dropped_frames_.load(std::memory_order_relaxed); }
+
  private:
+  RtdFrameQueue(size_t capacity, size_t min_buffer_size);
+  ~RtdFrameQueue() override;
+
+  // Recycles entries dropped by Clear() and peeks the first remaining one.
+  bool PeekValid(RtdFrameBuffer*& buffer);
+  // Position of the oldest entry not dropped yet.
+  uint64_t HeadPosition();
+  // Marks a queued entry dropped unless the reader took it first.
+  bool MarkDropped(RtdFrameBuffer* buffer);
+  // Returns an entry popped without handing it out to the free list.
+  void Recycle(RtdFrameBuffer* buffer);
+  // Pops the most recently freed slot. Producer side.
+  bool PopFreeSlot(RtdFrameBuffer*& buffer);
+  // Takes marked entries in [begin, end) out of |dropped_count_| before the
+  // flush position moves past them, and counts the unread ones as dropped.
+  // Producer side.
+  void UncountDropped(uint64_t begin, uint64_t end);
+
   size_t capacity_;
-  size_t default_size_;
-  mutable Mutex mutex_;
-  std::deque<RtdFrameBuffer*> queue_ RTC_GUARDED_BY(mutex_);
-  std::vector<RtdFrameBuffer*> free_list_ RTC_GUARDED_BY(mutex_);
+  RtdBufferPool pool_;  // only touched by the producer
+  std::vector<std::unique_ptr<RtdFrameBuffer>> slots_;
+  RtdSpscRing<RtdFrameBuffer*> queue_;      // producer -> consumer
+  RtdSpscRing<RtdFrameBuffer*> free_list_;  // consumer -> producer
+  // Slots drained from |free_list_|, most recently freed last. Producer only.
+  std::vector<RtdFrameBuffer*> reuse_stack_;
+  // Serializes pushes to |free_list_| from the threads freeing buffers. The
+  // producer pops without it.
+  mutable Mutex free_mutex_;
+  mutable std::atomic<int> ref_count_;
+  // Buffers handed out by ReadFront(), written by the consumer only; read
+  // under |free_mutex_| once |orphaned_|, when it no longer changes.
+  uint64_t taken_count_;
+  uint64_t freed_count_ RTC_GUARDED_BY(free_mutex_);
+  // The last reference went while buffers were out.
+  mutable bool orphaned_ RTC_GUARDED_BY(free_mutex_);
+  // Write position of |queue_| at the last Clear(), or first position kept by
+  // DropOldest(); everything before it is dropped by the consumer.
+  std::atomic<uint64_t> flush_position_;
+  // Entries in the ring marked kRtdBufferDropped and not recycled yet; they
+  // do not count against |capacity_|.
+  std::atomic<int64_t> dropped_count_;
+  std::atomic<uint64_t> dropped_frames_;
 
   //RTC_DISALLOW_COPY_AND_ASSIGN(RtdFrameQueue);
 };
@@ -66,4 +255,4 @@ class RtdFrameQueue {
 } // namespace rtd
 } // namespace webrtc
 
-#endif // !RTD_FRAME_QUEUE_H_
\ No newline at end of file
+#endif // !RTD_FRAME_QUEUE_H_
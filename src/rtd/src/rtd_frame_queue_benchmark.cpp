@@ -0,0 +1,267 @@
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "api/scoped_refptr.h"
+#include "benchmark/benchmark.h"
+#include "rtc_base/synchronization/mutex.h"
+#include "rtc_base/thread_annotations.h"
+#include "rtd_frame_queue.h"
+
+namespace webrtc {
+namespace rtd {
+namespace {
+
+constexpr size_t kCapacity = 64;
+constexpr size_t kMinBufferSize = 2048;
+
+// The queue RtdFrameQueue replaced: one mutex around a deque and a free
+// list, kept here as the baseline.
+class RtdMutexFrameQueue {
+ public:
+  struct Buffer {
+    rtc::Buffer* buffer = nullptr;
+    uint64_t pts = 0;
+    uint64_t dts = 0;
+    int flag = 0;
+    int duration = 0;
+    ~Buffer() { delete buffer; }
+  };
+
+  RtdMutexFrameQueue(size_t capacity, size_t default_size)
+      : capacity_(capacity), default_size_(default_size) {}
+  ~RtdMutexFrameQueue() {
+    for (Buffer* buffer : queue_) {
+      delete buffer;
+    }
+    for (Buffer* buffer : free_list_) {
+      delete buffer;
+    }
+  }
+
+  void Clear() {
+    MutexLock lock(&mutex_);
+    while (!queue_.empty()) {
+      free_list_.push_back(queue_.front());
+      queue_.pop_front();
+    }
+  }
+
+  bool ReadFront(Buffer*& buffer) {
+    MutexLock lock(&mutex_);
+    if (queue_.empty()) {
+      return false;
+    }
+    buffer = queue_.front();
+    queue_.pop_front();
+    return true;
+  }
+
+  void FreeBuffer(Buffer* buffer) {
+    MutexLock lock(&mutex_);
+    free_list_.push_back(buffer);
+  }
+
+  bool WriteBack(const void* data, size_t bytes, uint64_t pts, uint64_t dts, int duration, int flag = 0) {
+    MutexLock lock(&mutex_);
+    if (queue_.size() == capacity_) {
+      return false;
+    }
+
+    Buffer* packet;
+    if (!free_list_.empty()) {
+      packet = free_list_.back();
+      free_list_.pop_back();
+      if (packet->buffer->capacity() < bytes) {
+        delete packet->buffer;
+        packet->buffer = new rtc::Buffer(bytes, default_size_);
+      }
+    } else {
+      packet = new Buffer();
+      packet->buffer = new rtc::Buffer(bytes, default_size_);
+    }
+
+    packet->buffer->SetData(static_cast<const uint8_t*>(data), bytes);
+    packet->pts = pts;
+    packet->dts = dts;
+    packet->duration = duration;
+    packet->flag = flag;
+    queue_.push_back(packet);
+    return true;
+  }
+
+ private:
+  size_t capacity_;
+  size_t default_size_;
+  Mutex mutex_;
+  std::deque<Buffer*> queue_ RTC_GUARDED_BY(mutex_);
+  std::vector<Buffer*> free_list_ RTC_GUARDED_BY(mutex_);
+};
+
+// Owns a queue of either kind behind the same calls.
+template <typename Queue>
+struct QueueHolder {
+  using Buffer = RtdMutexFrameQueue::Buffer;
+  QueueHolder() : queue(new Queue(kCapacity, kMinBufferSize)) {}
+  Queue* get() { return queue.get(); }
+  std::unique_ptr<Queue> queue;
+};
+
+template <>
+struct QueueHolder<RtdFrameQueue> {
+  using Buffer = RtdFrameBuffer;
+  QueueHolder() : queue(RtdFrameQueue::Create(kCapacity, kMinBufferSize)) {}
+  RtdFrameQueue* get() { return queue.get(); }
+  rtc::scoped_refptr<RtdFrameQueue> queue;
+};
+
+// WriteBack, ReadFront and FreeBuffer on one thread: the uncontended cost.
+template <typename Queue>
+void BM_RoundTrip(benchmark::State& state) {
+  QueueHolder<Queue> holder;
+  Queue* queue = holder.get();
+  std::vector<uint8_t> frame(state.range(0), 0x5a);
+  uint64_t pts = 0;
+  for (auto _ : state) {
+    queue->WriteBack(frame.data(), frame.size(), pts, pts, 20);
+    ++pts;
+    typename QueueHolder<Queue>::Buffer* buffer = nullptr;
+    if (queue->ReadFront(buffer)) {
+      queue->FreeBuffer(buffer);
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * frame.size());
+}
+
+// The producer writes while a reader thread drains and frees, as the decode
+// and read threads do.
+template <typename Queue>
+void BM_CrossThread(benchmark::State& state) {
+  QueueHolder<Queue> holder;
+  Queue* queue = holder.get();
+  std::atomic<bool> stop(false);
+  std::thread reader([queue, &stop] {
+    while (!stop.load(std::memory_order_relaxed)) {
+      typename QueueHolder<Queue>::Buffer* buffer = nullptr;
+      if (queue->ReadFront(buffer)) {
+        queue->FreeBuffer(buffer);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  std::vector<uint8_t> frame(state.range(0), 0x5a);
+  uint64_t pts = 0;
+  for (auto _ : state) {
+    while (!queue->WriteBack(frame.data(), frame.size(), pts, pts, 20)) {
+      std::this_thread::yield();
+    }
+    ++pts;
+  }
+  stop.store(true);
+  reader.join();
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * frame.size());
+}
+
+// Flushing a full queue and reading past the flushed frames.
+template <typename Queue>
+void BM_ClearFull(benchmark::State& state) {
+  QueueHolder<Queue> holder;
+  Queue* queue = holder.get();
+  std::vector<uint8_t> frame(state.range(0), 0x5a);
+  uint64_t pts = 0;
+  for (auto _ : state) {
+    for (size_t i = 0; i < kCapacity; ++i) {
+      queue->WriteBack(frame.data(), frame.size(), pts, pts, 20);
+      ++pts;
+    }
+    queue->Clear();
+    typename QueueHolder<Queue>::Buffer* buffer = nullptr;
+    if (queue->ReadFront(buffer)) {
+      queue->FreeBuffer(buffer);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kCapacity);
+}
+
+// Producer-side drop of the oldest half of a full queue, racing no reader.
+void BM_DropOldest(benchmark::State& state) {
+  QueueHolder<RtdFrameQueue> holder;
+  RtdFrameQueue* queue = holder.get();
+  std::vector<uint8_t> frame(state.range(0), 0x5a);
+  uint64_t pts = 0;
+  for (auto _ : state) {
+    while (queue->WriteBack(frame.data(), frame.size(), pts, pts, 20)) {
+      pts += 20;
+    }
+    benchmark::DoNotOptimize(queue->DropOldest(kCapacity / 2 * 20, false));
+    RtdFrameBuffer* buffer = nullptr;
+    if (queue->ReadFront(buffer)) {
+      queue->FreeBuffer(buffer);
+    }
+  }
+}
+
+// Producer-side marking with the compare-and-swap the reader races against.
+void BM_DropDisposable(benchmark::State& state) {
+  QueueHolder<RtdFrameQueue> holder;
+  RtdFrameQueue* queue = holder.get();
+  std::vector<uint8_t> frame(state.range(0), 0x5a);
+  uint64_t pts = 0;
+  for (auto _ : state) {
+    while (queue->WriteBack(frame.data(), frame.size(), pts, pts, 20, kRtdFrameDisposable)) {
+      ++pts;
+    }
+    benchmark::DoNotOptimize(queue->DropDisposable(kCapacity));
+    queue->Clear();
+    RtdFrameBuffer* buffer = nullptr;
+    if (queue->ReadFront(buffer)) {
+      queue->FreeBuffer(buffer);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kCapacity);
+}
+
+void BM_SpscRingPushPop(benchmark::State& state) {
+  RtdSpscRing<int> ring(kCapacity);
+  int item = 0;
+  for (auto _ : state) {
+    ring.Push(item);
+    ring.Pop(item);
+    benchmark::DoNotOptimize(item);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void BM_BufferPoolAcquireRelease(benchmark::State& state) {
+  RtdBufferPool pool(kMinBufferSize);
+  for (auto _ : state) {
+    rtc::Buffer* buffer = pool.Acquire(state.range(0));
+    benchmark::DoNotOptimize(buffer);
+    pool.Release(buffer);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Audio frame, typical P frame, key frame.
+#define RTD_FRAME_SIZES ->Arg(400)->Arg(8 * 1024)->Arg(128 * 1024)
+
+BENCHMARK_TEMPLATE(BM_RoundTrip, RtdMutexFrameQueue) RTD_FRAME_SIZES;
+BENCHMARK_TEMPLATE(BM_RoundTrip, RtdFrameQueue) RTD_FRAME_SIZES;
+BENCHMARK_TEMPLATE(BM_CrossThread, RtdMutexFrameQueue) RTD_FRAME_SIZES->UseRealTime();
+BENCHMARK_TEMPLATE(BM_CrossThread, RtdFrameQueue) RTD_FRAME_SIZES->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ClearFull, RtdMutexFrameQueue)->Arg(400);
+BENCHMARK_TEMPLATE(BM_ClearFull, RtdFrameQueue)->Arg(400);
+BENCHMARK(BM_DropOldest)->Arg(400);
+BENCHMARK(BM_DropDisposable)->Arg(400);
+BENCHMARK(BM_SpscRingPushPop);
+BENCHMARK(BM_BufferPoolAcquireRelease) RTD_FRAME_SIZES;
+
+} // namespace
+} // namespace rtd
+} // namespace webrtc
@@ -0,0 +1,407 @@
+#include "rtd_frame_queue.h"
+
+#include <string.h>
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "api/scoped_refptr.h"
+#include "test/gtest.h"
+
+namespace webrtc {
+namespace rtd {
+namespace {
+
+constexpr size_t kCapacity = 8;
+constexpr size_t kMinBufferSize = 64;
+
+rtc::scoped_refptr<RtdFrameQueue> CreateQueue(size_t capacity = kCapacity) {
+  return RtdFrameQueue::Create(capacity, kMinBufferSize);
+}
+
+// Writes a frame whose payload is its pts, so reads can be checked.
+bool Write(RtdFrameQueue* queue, uint64_t pts, int flag = 0, size_t bytes = sizeof(uint64_t)) {
+  std::vector<uint8_t> data(bytes, 0);
+  memcpy(data.data(), &pts, sizeof(pts));
+  return queue->WriteBack(data.data(), data.size(), pts, pts, 20, flag);
+}
+
+// Reads, checks and frees one frame. Returns its pts, or -1 if empty.
+int64_t Read(RtdFrameQueue* queue) {
+  RtdFrameBuffer* buffer = nullptr;
+  if (!queue->ReadFront(buffer)) {
+    return -1;
+  }
+  uint64_t payload = 0;
+  memcpy(&payload, buffer->buffer->data(), sizeof(payload));
+  EXPECT_EQ(payload, buffer->pts);
+  int64_t pts = static_cast<int64_t>(buffer->pts);
+  queue->FreeBuffer(buffer);
+  return pts;
+}
+
+TEST(RtdSpscRingTest, PopsInPushOrder) {
+  RtdSpscRing<int> ring(4);
+  int item = 0;
+  EXPECT_FALSE(ring.Pop(item));
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(ring.Push(i));
+  }
+  EXPECT_FALSE(ring.Push(4));
+
+  uint64_t position = 0;
+  EXPECT_TRUE(ring.Peek(item, &position));
+  EXPECT_EQ(0, item);
+  EXPECT_EQ(0u, position);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(ring.Pop(item, &position));
+    EXPECT_EQ(i, item);
+    EXPECT_EQ(static_cast<uint64_t>(i), position);
+  }
+  EXPECT_FALSE(ring.Pop(item));
+}
+
+TEST(RtdSpscRingTest, PositionsKeepGrowingAcrossWraps) {
+  RtdSpscRing<int> ring(3);
+  int item = 0;
+  uint64_t position = 0;
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_TRUE(ring.Push(i));
+    EXPECT_EQ(i, ring.At(ring.WritePosition() - 1));
+    EXPECT_TRUE(ring.Pop(item, &position));
+    EXPECT_EQ(i, item);
+    EXPECT_EQ(static_cast<uint64_t>(i), position);
+  }
+  EXPECT_EQ(10u, ring.ReadPosition());
+  EXPECT_EQ(10u, ring.WritePosition());
+}
+
+TEST(RtdSpscRingTest, TwoThreadsKeepOrder) {
+  constexpr int kItems = 200000;
+  RtdSpscRing<int> ring(16);
+  std::thread producer([&ring] {
+    for (int i = 0; i < kItems;) {
+      if (ring.Push(i)) {
+        ++i;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  int expected = 0;
+  while (expected < kItems) {
+    int item = -1;
+    if (ring.Pop(item)) {
+      ASSERT_EQ(expected, item);
+      ++expected;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+}
+
+TEST(RtdBufferPoolTest, RoundsUpToSizeClass) {
+  RtdBufferPool pool(kMinBufferSize);
+  rtc::Buffer* buffer = pool.Acquire(100);
+  EXPECT_EQ(128u, buffer->capacity());
+  EXPECT_EQ(128u, pool.AllocatedBytes());
+  EXPECT_TRUE(pool.Fits(buffer, 65));
+  EXPECT_TRUE(pool.Fits(buffer, 128));
+  EXPECT_FALSE(pool.Fits(buffer, 64));
+  EXPECT_FALSE(pool.Fits(buffer, 129));
+  pool.Release(buffer);
+}
+
+TEST(RtdBufferPoolTest, ReusesReleasedBuffers) {
+  RtdBufferPool pool(kMinBufferSize);
+  rtc::Buffer* buffer = pool.Acquire(1000);
+  pool.Release(buffer);
+  EXPECT_EQ(1024u, pool.CachedBytes());
+  EXPECT_EQ(buffer, pool.Acquire(600));
+  EXPECT_EQ(0u, pool.CachedBytes());
+  EXPECT_EQ(1024u, pool.AllocatedBytes());
+  pool.Release(buffer);
+}
+
+TEST(RtdBufferPoolTest, CachesAtMostMaxPerClass) {
+  RtdBufferPool pool(kMinBufferSize);
+  std::vector<rtc::Buffer*> buffers;
+  for (size_t i = 0; i < RtdBufferPool::kMaxCachedPerClass + 1; ++i) {
+    buffers.push_back(pool.Acquire(kMinBufferSize));
+  }
+  for (rtc::Buffer* buffer : buffers) {
+    pool.Release(buffer);
+  }
+  EXPECT_EQ(RtdBufferPool::kMaxCachedPerClass * kMinBufferSize, pool.CachedBytes());
+  EXPECT_EQ(pool.CachedBytes(), pool.AllocatedBytes());
+}
+
+TEST(RtdBufferPoolTest, OversizedBuffersAreExact) {
+  RtdBufferPool pool(kMinBufferSize);
+  size_t oversized = (kMinBufferSize << RtdBufferPool::kNumClasses) + 1;
+  rtc::Buffer* buffer = pool.Acquire(oversized);
+  EXPECT_EQ(oversized, buffer->capacity());
+  EXPECT_TRUE(pool.Fits(buffer, oversized));
+  EXPECT_FALSE(pool.Fits(buffer, kMinBufferSize));
+  pool.Release(buffer);
+  EXPECT_EQ(0u, pool.AllocatedBytes());
+}
+
+TEST(RtdFrameQueueTest, ReadsWhatWasWritten) {
+  auto queue = CreateQueue();
+  const uint8_t data[] = {1, 2, 3, 4, 5};
+  EXPECT_TRUE(queue->WriteBack(data, sizeof(data), 40, 20, 33, kRtdFrameKey));
+  EXPECT_EQ(1u, queue->Size());
+
+  uint64_t dts = 0;
+  EXPECT_TRUE(queue->PeekFront(dts));
+  EXPECT_EQ(20u, dts);
+
+  RtdFrameBuffer* buffer = nullptr;
+  ASSERT_TRUE(queue->ReadFront(buffer));
+  EXPECT_EQ(sizeof(data), buffer->size);
+  EXPECT_EQ(0, memcmp(data, buffer->buffer->data(), sizeof(data)));
+  for (size_t i = 0; i < RTD_FRAME_PADDING_SIZE; ++i) {
+    EXPECT_EQ(0, buffer->buffer->data()[sizeof(data) + i]);
+  }
+  EXPECT_EQ(40u, buffer->pts);
+  EXPECT_EQ(20u, buffer->dts);
+  EXPECT_EQ(33, buffer->duration);
+  EXPECT_EQ(kRtdFrameKey, buffer->flag);
+  EXPECT_EQ(0u, queue->Size());
+  queue->FreeBuffer(buffer);
+  EXPECT_FALSE(queue->ReadFront(buffer));
+}
+
+TEST(RtdFrameQueueTest, RejectsWritesWhenFull) {
+  auto queue = CreateQueue();
+  for (size_t i = 0; i < kCapacity; ++i) {
+    EXPECT_TRUE(Write(queue.get(), i));
+  }
+  EXPECT_FALSE(Write(queue.get(), kCapacity));
+  EXPECT_EQ(0, Read(queue.get()));
+  EXPECT_TRUE(Write(queue.get(), kCapacity));
+}
+
+TEST(RtdFrameQueueTest, RejectsWritesWhileReaderHoldsEverySlot) {
+  auto queue = CreateQueue(2);
+  std::vector<RtdFrameBuffer*> held;
+  uint64_t pts = 0;
+  while (Write(queue.get(), pts)) {
+    RtdFrameBuffer* buffer = nullptr;
+    ASSERT_TRUE(queue->ReadFront(buffer));
+    held.push_back(buffer);
+    ++pts;
+  }
+  EXPECT_FALSE(held.empty());
+  queue->FreeBuffers(held.data(), held.size());
+  EXPECT_TRUE(Write(queue.get(), pts));
+}
+
+TEST(RtdFrameQueueTest, ClearFlushesQueuedFrames) {
+  auto queue = CreateQueue();
+  for (uint64_t pts = 0; pts < 5; ++pts) {
+    EXPECT_TRUE(Write(queue.get(), pts));
+  }
+  queue->Clear();
+  EXPECT_EQ(0u, queue->Size());
+  EXPECT_EQ(0, queue->BufferedMs());
+  EXPECT_EQ(5u, queue->DroppedFrames());
+
+  // Flushed entries still sit in the ring until the reader passes them, the
+  // producer can write a full queue anyway.
+  for (uint64_t pts = 100; pts < 100 + kCapacity; ++pts) {
+    EXPECT_TRUE(Write(queue.get(), pts));
+  }
+  for (int64_t pts = 100; pts < static_cast<int64_t>(100 + kCapacity); ++pts) {
+    EXPECT_EQ(pts, Read(queue.get()));
+  }
+  EXPECT_EQ(-1, Read(queue.get()));
+}
+
+TEST(RtdFrameQueueTest, ClearKeepsBuffersHeldByTheReader) {
+  auto queue = CreateQueue();
+  EXPECT_TRUE(Write(queue.get(), 7));
+  RtdFrameBuffer* buffer = nullptr;
+  ASSERT_TRUE(queue->ReadFront(buffer));
+  EXPECT_TRUE(Write(queue.get(), 8));
+  queue->Clear();
+  EXPECT_EQ(7u, buffer->pts);
+  EXPECT_EQ(-1, Read(queue.get()));
+  queue->FreeBuffer(buffer);
+}
+
+TEST(RtdFrameQueueTest, BufferKeepsQueueAlive) {
+  auto queue = CreateQueue();
+  EXPECT_TRUE(Write(queue.get(), 1));
+  RtdFrameBuffer* buffer = nullptr;
+  ASSERT_TRUE(queue->ReadFront(buffer));
+  RtdFrameQueue* owner = buffer->queue;
+  queue = nullptr;
+  EXPECT_EQ(1u, buffer->pts);
+  owner->FreeBuffer(buffer);
+}
+
+TEST(RtdFrameQueueTest, LastBufferFreedDeletesOrphanedQueue) {
+  auto queue = CreateQueue();
+  RtdFrameBuffer* buffers[3] = {nullptr};
+  for (uint64_t pts = 0; pts < 3; ++pts) {
+    EXPECT_TRUE(Write(queue.get(), pts));
+  }
+  for (RtdFrameBuffer*& buffer : buffers) {
+    ASSERT_TRUE(queue->ReadFront(buffer));
+  }
+  queue->FreeBuffer(buffers[0]);
+  RtdFrameQueue* owner = buffers[1]->queue;
+  queue = nullptr;
+  owner->FreeBuffer(buffers[1]);
+  EXPECT_EQ(2u, buffers[2]->pts);
+  owner->FreeBuffers(&buffers[2], 1);
+}
+
+TEST(RtdFrameQueueTest, DropOldestKeepsFromTheCut) {
+  auto queue = CreateQueue();
+  for (uint64_t pts = 0; pts <= 100; pts += 20) {
+    EXPECT_TRUE(Write(queue.get(), pts, pts == 60 ? kRtdFrameKey : 0));
+  }
+  EXPECT_EQ(100, queue->BufferedMs());
+  EXPECT_EQ(60, queue->DropOldest(30, true));
+  EXPECT_EQ(3u, queue->DroppedFrames());
+  EXPECT_EQ(3u, queue->Size());
+  EXPECT_EQ(20, queue->DropOldest(20, false));
+  EXPECT_EQ(80, Read(queue.get()));
+
+  // No key frame to cut at, everything goes.
+  EXPECT_EQ(-1, queue->DropOldest(0, true));
+  EXPECT_EQ(-1, Read(queue.get()));
+}
+
+TEST(RtdFrameQueueTest, DropBeforeDropsOlderFrames) {
+  auto queue = CreateQueue();
+  for (uint64_t pts = 0; pts <= 100; pts += 20) {
+    EXPECT_TRUE(Write(queue.get(), pts));
+  }
+  EXPECT_EQ(0, queue->DropBefore(0));
+  EXPECT_EQ(60, queue->DropBefore(50));
+  EXPECT_EQ(60, Read(queue.get()));
+  EXPECT_EQ(20, queue->DropBefore(1000));
+  EXPECT_EQ(0u, queue->Size());
+  EXPECT_EQ(-1, Read(queue.get()));
+}
+
+TEST(RtdFrameQueueTest, DropDisposableSkipsReferencedFrames) {
+  auto queue = CreateQueue();
+  for (uint64_t pts = 0; pts < 6; ++pts) {
+    EXPECT_TRUE(Write(queue.get(), pts, pts % 2 ? kRtdFrameDisposable : 0));
+  }
+  EXPECT_EQ(2u, queue->DropDisposable(2));
+  EXPECT_EQ(4u, queue->Size());
+  EXPECT_EQ(0, Read(queue.get()));
+  EXPECT_EQ(2, Read(queue.get()));
+  EXPECT_EQ(4, Read(queue.get()));
+  EXPECT_EQ(5, Read(queue.get()));
+  EXPECT_EQ(2u, queue->DroppedFrames());
+}
+
+TEST(RtdFrameQueueTest, DropGopTailsKeepsGopHeads) {
+  auto queue = CreateQueue();
+  // Two GOPs of three frames, then the next key frame.
+  for (uint64_t pts = 0; pts < 7; ++pts) {
+    EXPECT_TRUE(Write(queue.get(), pts, pts % 3 == 0 ? kRtdFrameKey : 0));
+  }
+  EXPECT_EQ(3u, queue->DropGopTails(3));
+  EXPECT_EQ(0, Read(queue.get()));
+  EXPECT_EQ(3, Read(queue.get()));
+  EXPECT_EQ(4, Read(queue.get()));
+  EXPECT_EQ(6, Read(queue.get()));
+}
+
+// The producer marks frames dropped while the reader takes them; every frame
+// goes exactly one way.
+TEST(RtdFrameQueueTest, ConcurrentDropsAndReadsAccountEveryFrame) {
+  constexpr uint64_t kFrames = 100000;
+  auto queue = CreateQueue(32);
+  std::atomic<bool> done(false);
+  std::thread producer([&queue, &done] {
+    for (uint64_t pts = 0; pts < kFrames;) {
+      if (Write(queue.get(), pts, pts % 2 ? kRtdFrameDisposable : 0)) {
+        ++pts;
+      } else {
+        std::this_thread::yield();
+      }
+      if (pts % 7 == 0) {
+        queue->DropDisposable(1);
+      }
+    }
+    done.store(true);
+  });
+
+  std::set<int64_t> read;
+  int64_t last = -1;
+  while (true) {
+    bool finished = done.load();
+    int64_t pts = Read(queue.get());
+    if (pts < 0) {
+      if (finished) {
+        break;
+      }
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_GT(pts, last);
+    last = pts;
+    read.insert(pts);
+  }
+  producer.join();
+
+  EXPECT_EQ(kFrames, read.size() + queue->DroppedFrames());
+  EXPECT_EQ(0u, queue->Size());
+}
+
+TEST(RtdFrameQueueTest, ConcurrentClearsNeverReplayFrames) {
+  constexpr uint64_t kFrames = 100000;
+  auto queue = CreateQueue(32);
+  std::atomic<bool> done(false);
+  std::thread producer([&queue, &done] {
+    for (uint64_t pts = 0; pts < kFrames;) {
+      if (Write(queue.get(), pts)) {
+        ++pts;
+      } else {
+        std::this_thread::yield();
+      }
+      if (pts % 1000 == 0) {
+        queue->Clear();
+      }
+    }
+    done.store(true);
+  });
+
+  int64_t last = -1;
+  while (true) {
+    bool finished = done.load();
+    int64_t pts = Read(queue.get());
+    if (pts < 0) {
+      if (finished) {
+        break;
+      }
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_GT(pts, last);
+    last = pts;
+  }
+  producer.join();
+
+  EXPECT_EQ(0u, queue->Size());
+  // Every slot is back, a full queue can be written.
+  for (uint64_t pts = 0; pts < 32; ++pts) {
+    EXPECT_TRUE(Write(queue.get(), kFrames + pts));
+  }
+}
+
+} // namespace
+} // namespace rtd
+} // namespace webrtc
@@ -34,6 +34,14 @@ typedef struct RtdAudioFrame {
   RtdAudioCodecType codec_type;
 } RtdAudioFrame;
 
+typedef struct RtdEncodedAudioFrame {
+  const uint8_t* data;
+  size_t size;
+  int64_t timestamp_ms;
+  int64_t timestamp_rtp;
+  int duration_ms;
+} RtdEncodedAudioFrame;
+
 typedef struct RtdVideoFrame {
   uint8_t* data;
   size_t size;
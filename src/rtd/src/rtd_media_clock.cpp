@@ -0,0 +1,129 @@
+#include "rtd_media_clock.h"
+#include "rtc_base/logging.h"
+#include "system_wrappers/include/ntp_time.h"
+
+namespace webrtc {
+namespace rtd {
+
+RtdMediaClock::RtdMediaClock(Clock* clock)
+    : clock_(clock),
+      start_ms_(-1),
+      ntp_offset_set_(false),
+      ntp_offset_ms_(0) {
+  for (uint32_t& ssrc : ssrc_) {
+    ssrc = 0;
+  }
+}
+
+RtdMediaClock::~RtdMediaClock() {}
+
+RtdMediaClock::Stream& RtdMediaClock::CurrentStream(int media) {
+  return streams_[StreamKey(media, ssrc_[media])];
+}
+
+void RtdMediaClock::OnPacketInfos(int media, const RtpPacketInfos& packet_infos) {
+  if (packet_infos.empty()) {
+    return;
+  }
+
+  MutexLock lock(&mutex_);
+  uint32_t ssrc = packet_infos.back().ssrc();
+  if (ssrc != ssrc_[media]) {
+    RTC_LOG(LS_INFO) << "RtdMediaClock::OnPacketInfos() media:" << media << " ssrc:" << ssrc_[media]
+                     << " -> " << ssrc;
+    auto unknown = streams_.find(StreamKey(media, 0));
+    if (ssrc_[media] == 0 && unknown != streams_.end()) {
+      streams_[StreamKey(media, ssrc)] = unknown->second;
+      streams_.erase(unknown);
+    }
+    ssrc_[media] = ssrc;
+  }
+
+  Stream& stream = CurrentStream(media);
+  for (const RtpPacketInfo& info : packet_infos) {
+    if (info.ssrc() != ssrc || !info.absolute_capture_time()) {
+      continue;
+    }
+    if (stream.last_rtp < 0) {
+      stream.last_rtp = stream.unwrapper.Unwrap(info.rtp_timestamp());
+    }
+    // Unwrap against the last timestamp, without moving the unwrapper.
+    int64_t rtp = stream.last_rtp +
+                  static_cast<int32_t>(info.rtp_timestamp() - static_cast<uint32_t>(stream.last_rtp));
+    if (stream.capture_rtp < 0) {
+      RTC_LOG(LS_INFO) << "RtdMediaClock::OnPacketInfos() media:" << media << " ssrc:" << ssrc
+                       << " first capture time, rtp:" << info.rtp_timestamp();
+    }
+    stream.capture_rtp = rtp;
+    stream.capture_ntp_ms = UQ32x32ToInt64Ms(info.absolute_capture_time()->absolute_capture_timestamp);
+  }
+}
+
+void RtdMediaClock::OnSenderReport(int media, uint32_t ssrc, uint32_t rtp_timestamp, int64_t ntp_ms) {
+  MutexLock lock(&mutex_);
+  auto it = streams_.find(StreamKey(media, ssrc));
+  if (it == streams_.end() || it->second.last_rtp < 0) {
+    return;
+  }
+
+  Stream& stream = it->second;
+  // Unwrap against the last timestamp, without moving the unwrapper.
+  int64_t rtp = stream.last_rtp + static_cast<int32_t>(rtp_timestamp - static_cast<uint32_t>(stream.last_rtp));
+  if (stream.capture_rtp < 0) {
+    RTC_LOG(LS_INFO) << "RtdMediaClock::OnSenderReport() media:" << media << " ssrc:" << ssrc
+                     << " first capture time, rtp:" << rtp_timestamp;
+  }
+  stream.capture_rtp = rtp;
+  stream.capture_ntp_ms = ntp_ms;
+}
+
+int64_t RtdMediaClock::Unwrap(int media, uint32_t rtp_timestamp) {
+  MutexLock lock(&mutex_);
+  Stream& stream = CurrentStream(media);
+  stream.last_rtp = stream.unwrapper.Unwrap(rtp_timestamp);
+  return stream.last_rtp;
+}
+
+int64_t RtdMediaClock::ToMs(int media, int64_t unwrapped_rtp, int clock_khz) {
+  MutexLock lock(&mutex_);
+  int64_t now_ms = clock_->TimeInMilliseconds();
+  if (start_ms_ < 0) {
+    start_ms_ = now_ms;
+  }
+  Stream& stream = CurrentStream(media);
+  if (stream.first_rtp < 0) {
+    stream.first_rtp = unwrapped_rtp;
+    stream.first_local_ms = now_ms;
+  }
+
+  int64_t local_ms = stream.first_local_ms - start_ms_ + (unwrapped_rtp - stream.first_rtp) / clock_khz;
+  if (stream.capture_rtp < 0) {
+    return local_ms;
+  }
+
+  int64_t ntp_ms = stream.capture_ntp_ms + (unwrapped_rtp - stream.capture_rtp) / clock_khz;
+  if (!ntp_offset_set_) {
+    // The first stream on the sender's clock keeps its place.
+    ntp_offset_ms_ = ntp_ms - local_ms;
+    ntp_offset_set_ = true;
+  }
+  return ntp_ms - ntp_offset_ms_;
+}
+
+uint32_t RtdMediaClock::Ssrc(int media) {
+  MutexLock lock(&mutex_);
+  return ssrc_[media];
+}
+
+void RtdMediaClock::Rebase() {
+  MutexLock lock(&mutex_);
+  RTC_LOG(LS_INFO) << "RtdMediaClock::Rebase()";
+  streams_.clear();
+  for (uint32_t& ssrc : ssrc_) {
+    ssrc = 0;
+  }
+  ntp_offset_set_ = false;
+}
+
+} // namespace rtd
+} // namespace webrtc
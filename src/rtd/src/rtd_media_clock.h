@@ -0,0 +1,88 @@
+#ifndef RTD_MEDIA_CLOCK_H_
+#define RTD_MEDIA_CLOCK_H_
+
+#include <stdint.h>
+#include <map>
+#include <utility>
+
+#include "api/rtp_packet_infos.h"
+#include "rtc_base/synchronization/mutex.h"
+#include "rtc_base/thread_annotations.h"
+#include "rtc_base/time_utils.h"
+#include "system_wrappers/include/clock.h"
+
+namespace webrtc {
+namespace rtd {
+
+enum RtdClockMedia {
+  kRtdClockAudio = 0,
+  kRtdClockVideo,
+  kRtdClockMediaCount,
+};
+
+// Maps the rtp timestamps of audio and video onto one zero-based ms timeline.
+//
+// Every (media, ssrc) is unwrapped on its own. A stream is first placed by the
+// local time its first frame came out; once it has a capture time (an RTCP
+// sender report passed to OnSenderReport(), or the absolute capture time
+// extension in its packet infos) it follows the sender's NTP clock.
+// The first stream to get one keeps its position, the others move onto it,
+// which fixes their lip-sync once.
+//
+// Thread safe, audio and video arrive on different threads.
+class RtdMediaClock {
+ public:
+  explicit RtdMediaClock(Clock* clock);
+  ~RtdMediaClock();
+
+  // Picks up the ssrc and the capture times in |packet_infos|, whose rtp
+  // timestamps must be on the clock later passed to ToMs().
+  void OnPacketInfos(int media, const RtpPacketInfos& packet_infos);
+
+  // Maps |rtp_timestamp| of stream (|media|, |ssrc|) to |ntp_ms|, as the
+  // receiver's last RTCP sender report did. Ignored before the stream's
+  // first frame.
+  void OnSenderReport(int media, uint32_t ssrc, uint32_t rtp_timestamp, int64_t ntp_ms);
+
+  // Unwraps |rtp_timestamp| of the stream |media| last saw in OnPacketInfos().
+  int64_t Unwrap(int media, uint32_t rtp_timestamp);
+
+  // Timeline position, in ms, of an rtp timestamp returned by Unwrap().
+  int64_t ToMs(int media, int64_t unwrapped_rtp, int clock_khz);
+
+  // Ssrc |media| is on now, 0 before the first OnPacketInfos().
+  uint32_t Ssrc(int media);
+
+  // Forgets all streams, e.g. on a channel switch. The timeline goes on:
+  // the next streams are placed by local time again, then the first with a
+  // capture time sets the NTP mapping anew.
+  void Rebase();
+
+ private:
+  struct Stream {
+    rtc::TimestampWrapAroundHandler unwrapper;
+    int64_t last_rtp = -1;        // unwrapped
+    int64_t first_rtp = -1;       // unwrapped, first one mapped by ToMs()
+    int64_t first_local_ms = 0;
+    int64_t capture_rtp = -1;     // unwrapped rtp of the latest capture time
+    int64_t capture_ntp_ms = 0;
+  };
+  typedef std::pair<int, uint32_t> StreamKey;   // media, ssrc
+
+  // Stream |media| is on now. Frames seen before the first ssrc is known go
+  // to ssrc 0, which the first real one then takes over.
+  Stream& CurrentStream(int media) RTC_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  Clock* const clock_;
+  Mutex mutex_;
+  std::map<StreamKey, Stream> streams_ RTC_GUARDED_BY(mutex_);
+  uint32_t ssrc_[kRtdClockMediaCount] RTC_GUARDED_BY(mutex_);
+  int64_t start_ms_ RTC_GUARDED_BY(mutex_);          // local, -1 before any frame
+  bool ntp_offset_set_ RTC_GUARDED_BY(mutex_);
+  int64_t ntp_offset_ms_ RTC_GUARDED_BY(mutex_);     // NTP ms at timeline 0
+};
+
+} // namespace rtd
+} // namespace webrtc
+
+#endif // !RTD_MEDIA_CLOCK_H_
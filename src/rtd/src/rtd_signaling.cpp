@@ -9,7 +9,6 @@ namespace {
 constexpr int kDefaultSignalingTimeoutMs = 5000; // ms
 constexpr int kDefaultSignalingConnTimeoutMs = 2000; //ms
 constexpr char kSignalingServerDomain[] = "http://wecan-api.netease.im/v1/live/play";
-constexpr char kWhipSignalingServerDomain[] = "https://wecan-api.netease.im/v1/whip/endpoint/play";
 constexpr char kSdkVersion[] = "1.2.0";
 constexpr char kTestAppkey[] = "c5057dc8294ed41e2f45cfd17ae83ac5"; // for test, can change the value based on the actual situation
 
@@ -21,7 +20,6 @@ namespace rtd {
 RtdSignaling::RtdSignaling(const std::string& url)
     : url_(url),
       server_domain_(kSignalingServerDomain),
-      whip_server_domain_(kWhipSignalingServerDomain),
       request_id_(""),
       cid_(""),
       uid_(""),
@@ -33,11 +31,16 @@ RtdSignaling::~RtdSignaling() {
   RTC_LOG(LS_INFO) << "RtdSignaling::~RtdSignaling().";
 }
 
-int RtdSignaling::ConnectAndWaitResponse(std::string& offer_sdp, std::string* answer_sdp) {
-  RTC_LOG(LS_INFO) << "RtdSignaling::ConnectAndWaitResponse";
+void RtdSignaling::Prewarm() {
+  RTC_LOG(LS_INFO) << "RtdSignaling::Prewarm().";
+  RtdHttp::Prewarm(kSignalingServerDomain, kDefaultSignalingConnTimeoutMs);
+}
+
+int RtdSignaling::Connect(const std::string& offer_sdp, ResponseCallback done) {
+  RTC_LOG(LS_INFO) << "RtdSignaling::Connect";
   http_.reset(new RtdHttp(server_domain_, timeout_ms_, kDefaultSignalingConnTimeoutMs));
-  if (!http_) {
-    RTC_LOG(LS_ERROR) << "RtdSignaling::ConnectAndWaitResponse signaling instance is nullptr.";
+  if (!http_ || !http_->IsInitialized()) {
+    RTC_LOG(LS_ERROR) << "RtdSignaling::Connect signaling instance is nullptr.";
     return -1;
   }
   Json::StreamWriterBuilder writer_builder;
@@ -64,25 +67,43 @@ int RtdSignaling::ConnectAndWaitResponse(std::string& offer_sdp, std::string* an
   http_->AddHeader("Content-Type", "application/json");
   http_->AddHeader("RequestId", request_id_);
   http_->AddContent(true, "", request_str);
-  RTC_LOG(LS_INFO) << "RtdSignaling::DoEasy send request";
-  int curl_code = http_->DoEasy();
-  if (curl_code != 0) {
-    RTC_LOG(LS_ERROR) << "RtdSignaling::DoEasy failed. code:" << curl_code;
-    return -1;
+  RTC_LOG(LS_INFO) << "RtdSignaling::DoAsync send request";
+  RtdHttp* http = http_.get();
+  bool started = http_->DoAsync([this, http, done](int curl_code) {
+    std::string answer_sdp;
+    RtdHttpTiming timing = http->GetTiming();
+    if (curl_code != 0) {
+      RTC_LOG(LS_ERROR) << "RtdSignaling::DoAsync failed. code:" << curl_code;
+      done(-1, answer_sdp, timing);
+      return;
+    }
+    RTC_LOG(LS_INFO) << "RtdSignaling::DoAsync success. code:" << curl_code << " dns_ms:" << timing.dns_ms
+                     << " connect_ms:" << timing.connect_ms << " tls_ms:" << timing.tls_ms
+                     << " first_byte_ms:" << timing.first_byte_ms;
+    int code = ParseResponse(http->GetContent(), &answer_sdp);
+    done(code, answer_sdp, timing);
+  });
+  return started ? 0 : -1;
+}
+
+void RtdSignaling::Cancel() {
+  if (http_) {
+    http_->Cancel();
   }
+}
 
-  RTC_LOG(LS_INFO) << "RtdSignaling::DoEasy success. code:" << curl_code;
+int RtdSignaling::ParseResponse(const std::string& content, std::string* answer_sdp) {
   Json::CharReaderBuilder reader_builder;
   std::unique_ptr<Json::CharReader> reader(reader_builder.newCharReader());
   std::string json_err;
 
-  root.clear();
-  std::string content = http_->GetContent();
+  Json::Value root;
   if (!reader->parse(content.c_str(), content.c_str() + content.length(), &root, &json_err) || !root.isObject()) {
     RTC_LOG(LS_ERROR) << "RtdSignaling Response Json parse failed:" << json_err.c_str() << " Content:" << content.c_str();
     return -1;
   }
 
+  Json::StreamWriterBuilder writer_builder;
   writer_builder["commentStyle"] = "All";
   writer_builder["indentation"] = "	";
 
@@ -106,35 +127,8 @@ int RtdSignaling::ConnectAndWaitResponse(std::string& offer_sdp, std::string* an
     RTC_LOG(LS_ERROR) << "RtdSignaling consultation failed. code:" << code << " err_msg:" << err_msg;
   }
 
-  http_.reset(nullptr);
   return code;
 }
 
-int RtdSignaling::ConnectAndWaitResponseByWhip(std::string& offer_sdp, std::string* answer_sdp) {
-  RTC_LOG(LS_INFO) << "RtdSignaling::ConnectAndWaitResponseByWhip";
-  std::string url = whip_server_domain_ + "?streamUri=" + url_ + "&appkey=" + kTestAppkey;
-  RTC_LOG(LS_INFO) << "RtdSignaling::ConnectAndWaitResponseByWhip url:" << url;
-  RtdHttp http(url, timeout_ms_, kDefaultSignalingConnTimeoutMs);
-  http.AddHeader("Content-Type", "application/sdp");
-  http.AddContent(true, "", offer_sdp);
-
-  int curl_code = http.DoEasy();
-  if (curl_code != 0) {
-    RTC_LOG(LS_ERROR) << "RtdSignaling::DoEasyPerform failed. code:" << curl_code;
-    return -1;
-  }
-
-  std::string content = http.GetContent();
-  RTC_LOG(LS_INFO) << "RtdSignaling::DoEasyPerform success. content:" << content;
-  long http_status_code = http.GetHttpStatusCode();
-  RTC_LOG(LS_INFO) << "RtdSignaling::DoEasyPerform success. http_status_code:" << http_status_code;
-  if (http_status_code == 201) {
-    *answer_sdp = content;
-  } else {
-    return http_status_code;
-  }
-  return 200;
-}
-
 } // namespace rtd
 } // namespace webrtc
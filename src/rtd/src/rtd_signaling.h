@@ -1,6 +1,7 @@
 #ifndef RTD_SIGNALING_H_
 #define RTD_SIGNALING_H_
 
+#include <functional>
 #include <memory>
 #include "third_party/http/src/rtd_http.h"
 
@@ -13,16 +14,29 @@ class RtdSignaling {
   RtdSignaling(const std::string& url);
   ~RtdSignaling();
 
+  // Opens a kept-alive connection to the signaling server in the background,
+  // which the next Connect() reuses.
+  static void Prewarm();
+
+  // code is 200 on success, answer_sdp is then the answer.
+  typedef std::function<void(int code, const std::string& answer_sdp, const RtdHttpTiming& timing)>
+      ResponseCallback;
+
   void SetId(std::string& id) { request_id_ = id; }
-  int ConnectAndWaitResponse(std::string& offer_sdp, std::string* answer_sdp);
-  int ConnectAndWaitResponseByWhip(std::string& offer_sdp, std::string* answer_sdp);
+  // Sends the offer without blocking, |done| is called on the http thread.
+  // Returns -1 if the request could not be started.
+  int Connect(const std::string& offer_sdp, ResponseCallback done);
+  // Stops Connect(). Once this returns |done| is not running and will not be
+  // called. Same thread as Connect().
+  void Cancel();
   std::string GetId();
 
  private:
+  int ParseResponse(const std::string& content, std::string* answer_sdp);
+
   std::unique_ptr<RtdHttp> http_;
   std::string url_;
   std::string server_domain_;
-  std::string whip_server_domain_;
   std::string request_id_;
   std::string cid_;
   std::string uid_;
@@ -1,5 +1,11 @@
 #include "rtd_http.h"
 
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #ifndef CURL_STATICLIB
 #define CURL_STATICLIB
 #endif
@@ -16,15 +22,184 @@
 #endif
 
 #define MAX_CONTENT_SIZE 20000
+// Longest a started or cancelled request waits for the loop to notice it.
+// curl 7.58 has no curl_multi_wakeup().
+#define LOOP_WAIT_MS 10
 
-int RtdHttp::count_ = 0;
+// Seconds a cached DNS entry is used.
+#define DNS_CACHE_TIMEOUT_S (60*5)
 
-RtdHttp::RtdHttp(const std::string & url, int timeout, int conn_timeout_ms) 
-    : url_(url) {
-  if (count_++ == 0) {
+// curl state shared by every RtdHttp of the process: initializes curl once,
+// and shares the DNS cache, TLS sessions and kept-alive connections, so a
+// request to a host seen before skips the TCP and TLS handshakes. Never
+// destroyed, the connections stay open for the next request.
+class RtdHttpShared {
+public:
+  static RtdHttpShared* Get() {
+    // Thread safe since C++11.
+    static RtdHttpShared* const shared = new RtdHttpShared();
+    return shared;
+  }
+
+  CURLSH* handle() const { return handle_; }
+
+private:
+  RtdHttpShared() {
     curl_global_init(CURL_GLOBAL_ALL);
+    handle_ = curl_share_init();
+    if (!handle_) {
+      return;
+    }
+    curl_share_setopt(handle_, CURLSHOPT_LOCKFUNC, Lock);
+    curl_share_setopt(handle_, CURLSHOPT_UNLOCKFUNC, Unlock);
+    curl_share_setopt(handle_, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(handle_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(handle_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(handle_, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+  }
+
+  static void Lock(CURL* handle, curl_lock_data data, curl_lock_access access, void* param) {
+    static_cast<RtdHttpShared*>(param)->mutexes_[data].lock();
+  }
+
+  static void Unlock(CURL* handle, curl_lock_data data, void* param) {
+    static_cast<RtdHttpShared*>(param)->mutexes_[data].unlock();
+  }
+
+  CURLSH* handle_ = nullptr;
+  std::mutex mutexes_[CURL_LOCK_DATA_LAST];
+};
+
+// One thread running the requests of every RtdHttp::DoAsync() on a curl multi
+// handle. Never destroyed.
+class RtdHttpLoop {
+public:
+  static RtdHttpLoop* Get() {
+    static RtdHttpLoop* const loop = new RtdHttpLoop();
+    return loop;
+  }
+
+  bool Add(RtdHttp* http) {
+    if (!multi_) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    adding_.push_back(http);
+    cv_.notify_all();
+    return true;
+  }
+
+  void Remove(RtdHttp* http) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (Erase(adding_, http)) {
+      return;
+    }
+    if (std::this_thread::get_id() == thread_.get_id()) {
+      // From a |done| callback, the loop is not inside curl.
+      if (Erase(running_, http)) {
+        curl_multi_remove_handle(multi_, http->curl_handle_);
+      }
+      return;
+    }
+    if (Contains(running_, http) && !Contains(removing_, http)) {
+      removing_.push_back(http);
+    }
+    cv_.wait(lock, [this, http] { return !Contains(running_, http) && completing_ != http; });
+  }
+
+private:
+  RtdHttpLoop() {
+    RtdHttpShared::Get();
+    multi_ = curl_multi_init();
+    if (multi_) {
+      thread_ = std::thread([this] { Run(); });
+    }
+  }
+
+  static bool Contains(const std::vector<RtdHttp*>& list, RtdHttp* http) {
+    return std::find(list.begin(), list.end(), http) != list.end();
+  }
+
+  static bool Erase(std::vector<RtdHttp*>& list, RtdHttp* http) {
+    auto it = std::find(list.begin(), list.end(), http);
+    if (it == list.end()) {
+      return false;
+    }
+    list.erase(it);
+    return true;
   }
 
+  void Run() {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !adding_.empty() || !running_.empty(); });
+        for (RtdHttp* http : removing_) {
+          curl_multi_remove_handle(multi_, http->curl_handle_);
+          Erase(running_, http);
+        }
+        removing_.clear();
+        for (RtdHttp* http : adding_) {
+          curl_multi_add_handle(multi_, http->curl_handle_);
+          running_.push_back(http);
+        }
+        adding_.clear();
+        cv_.notify_all();
+      }
+
+      int still_running = 0;
+      curl_multi_perform(multi_, &still_running);
+      int queued = 0;
+      while (CURLMsg* msg = curl_multi_info_read(multi_, &queued)) {
+        if (msg->msg != CURLMSG_DONE) {
+          continue;
+        }
+        CURL* handle = msg->easy_handle;
+        int code = msg->data.result;
+        std::function<void(int)> done;
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          auto it = std::find_if(running_.begin(), running_.end(),
+                                 [handle](RtdHttp* http) { return http->curl_handle_ == handle; });
+          if (it == running_.end()) {
+            continue;
+          }
+          RtdHttp* http = *it;
+          running_.erase(it);
+          curl_multi_remove_handle(multi_, handle);
+          if (Erase(removing_, http)) {
+            // Cancelled, the canceller is waiting.
+            cv_.notify_all();
+            continue;
+          }
+          completing_ = http;
+          done = http->done_;
+        }
+        if (done) {
+          done(code);
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        completing_ = nullptr;
+        cv_.notify_all();
+      }
+
+      curl_multi_wait(multi_, nullptr, 0, LOOP_WAIT_MS, nullptr);
+    }
+  }
+
+  CURLM* multi_ = nullptr;
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<RtdHttp*> adding_;    // by Add(), not on |multi_| yet
+  std::vector<RtdHttp*> running_;   // on |multi_|
+  std::vector<RtdHttp*> removing_;  // by Remove(), still on |multi_|
+  RtdHttp* completing_ = nullptr;   // its |done_| is running
+};
+
+RtdHttp::RtdHttp(const std::string & url, int timeout, int conn_timeout_ms) 
+    : url_(url) {
+  RtdHttpShared::Get();
   curl_handle_ = curl_easy_init();
   if (!curl_handle_) {
     return;
@@ -38,12 +213,14 @@ RtdHttp::RtdHttp(const std::string & url, int timeout, int conn_timeout_ms)
   }
 
   curl_easy_setopt(curl_handle_, CURLOPT_URL, url.c_str());
+  curl_easy_setopt(curl_handle_, CURLOPT_TCP_KEEPALIVE, 1L);
   SetSharedHandler();
 
   initialized_ = true;
 }
 
 RtdHttp::~RtdHttp() {
+  Cancel();
   if (curl_list_) {
     curl_slist_free_all(curl_list_);
   }
@@ -51,10 +228,16 @@ RtdHttp::~RtdHttp() {
   if (curl_handle_) {
     curl_easy_cleanup(curl_handle_);
   }
+}
 
-  if (--count_ <= 0) {
-    curl_global_cleanup();
-    count_ = 0;
+void RtdHttp::Prewarm(const std::string& url, int conn_timeout_ms) {
+  // A HEAD request leaves a kept-alive connection, TLS session included, in
+  // the shared cache. Whatever the server answers, the connection is what
+  // counts.
+  RtdHttp* http = new RtdHttp(url, conn_timeout_ms, conn_timeout_ms);
+  curl_easy_setopt(http->curl_handle_, CURLOPT_NOBODY, 1L);
+  if (!http->DoAsync([http](int code) { delete http; })) {
+    delete http;
   }
 }
 
@@ -69,7 +252,8 @@ void RtdHttp::AddContent(bool post, const std::string& form_post, const std::str
     curl_easy_setopt(curl_handle_, CURLOPT_HTTPPOST, form_post.c_str());
   } else {
     if (!post_field.empty()) {
-      curl_easy_setopt(curl_handle_, CURLOPT_POSTFIELDS, post_field.c_str());
+      // Copied, DoAsync() sends after the caller's string is gone.
+      curl_easy_setopt(curl_handle_, CURLOPT_COPYPOSTFIELDS, post_field.c_str());
     }
   }
 
@@ -83,21 +267,25 @@ void RtdHttp::AddContent(bool post, const std::string& form_post, const std::str
 }
 
 void RtdHttp::SetSharedHandler() {
-  static CURLSH* shared_handler = nullptr;
-  if (!shared_handler) {
-    shared_handler = curl_share_init();
-    curl_share_setopt(shared_handler, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  CURLSH* shared_handler = RtdHttpShared::Get()->handle();
+  if (shared_handler) {
+    curl_easy_setopt(curl_handle_, CURLOPT_SHARE, shared_handler);
   }
-  curl_easy_setopt(curl_handle_, CURLOPT_SHARE, shared_handler);
-  curl_easy_setopt(curl_handle_, CURLOPT_DNS_CACHE_TIMEOUT, 60*5);
+  curl_easy_setopt(curl_handle_, CURLOPT_DNS_CACHE_TIMEOUT, DNS_CACHE_TIMEOUT_S);
 }
 
-int RtdHttp::DoEasy() {
-  CURLcode code = CURL_LAST;
-  if (curl_handle_) {
-    code = curl_easy_perform(curl_handle_);
+bool RtdHttp::DoAsync(std::function<void(int)> done) {
+  if (!curl_handle_) {
+    return false;
+  }
+  done_ = std::move(done);
+  return RtdHttpLoop::Get()->Add(this);
+}
+
+void RtdHttp::Cancel() {
+  if (done_) {
+    RtdHttpLoop::Get()->Remove(this);
   }
-  return code;
 }
 
 std::string RtdHttp::GetContent() {
@@ -112,6 +300,27 @@ long RtdHttp::GetHttpStatusCode() {
   return http_code;
 }
 
+RtdHttpTiming RtdHttp::GetTiming() {
+  RtdHttpTiming timing;
+  if (!curl_handle_) {
+    return timing;
+  }
+  double seconds = 0;
+  if (curl_easy_getinfo(curl_handle_, CURLINFO_NAMELOOKUP_TIME, &seconds) == CURLE_OK) {
+    timing.dns_ms = (int)(seconds * 1000);
+  }
+  if (curl_easy_getinfo(curl_handle_, CURLINFO_CONNECT_TIME, &seconds) == CURLE_OK) {
+    timing.connect_ms = (int)(seconds * 1000);
+  }
+  if (curl_easy_getinfo(curl_handle_, CURLINFO_APPCONNECT_TIME, &seconds) == CURLE_OK) {
+    timing.tls_ms = (int)(seconds * 1000);
+  }
+  if (curl_easy_getinfo(curl_handle_, CURLINFO_STARTTRANSFER_TIME, &seconds) == CURLE_OK) {
+    timing.first_byte_ms = (int)(seconds * 1000);
+  }
+  return timing;
+}
+
 size_t RtdHttp::WriteMemory(void* data, size_t size, size_t count, void * param) {
   if (data == nullptr) {
     return 0;
@@ -1,35 +1,55 @@
 #ifndef RTD_HTTP_H_
 #define RTD_HTTP_H_
 
+#include <functional>
 #include <string>
 
 struct curl_slist;
 
+// Phases of a request in ms since it started, as reported by curl.
+struct RtdHttpTiming
+{
+	int dns_ms = -1;
+	int connect_ms = -1;
+	int tls_ms = -1;
+	int first_byte_ms = -1;
+};
+
 class RtdHttp
 {
 public:
 	RtdHttp(const std::string& url, int timeout, int conn_timeout_ms);
 	~RtdHttp();
 	bool IsInitialized() { return initialized_; }
+	// Connects to |url| in the background, so the next request to its host
+	// reuses the connection. Any thread.
+	static void Prewarm(const std::string& url, int conn_timeout_ms);
 
 	void AddHeader(const std::string& name, const std::string& value);
 	void AddContent(bool post, const std::string& form_post, const std::string& post_field);
 	void SetSharedHandler();
-	int  DoEasy();
+	// Runs the request on the shared http thread instead of blocking, and
+	// calls |done| there with the curl code. Returns false if not started.
+	bool DoAsync(std::function<void(int)> done);
+	// Stops a request started by DoAsync(). Once this returns |done| is not
+	// running and will not be called. Also done by the destructor.
+	void Cancel();
 	std::string GetContent();
 	long GetHttpStatusCode();
+	RtdHttpTiming GetTiming();
 
 private:
+	friend class RtdHttpLoop;
 	static size_t WriteMemory(void *data, size_t size, size_t count, void* param);
 
 private:
-	static int count_;
 	bool initialized_ = false;
 	std::string url_;
 	std::string content_;
 	int content_bytes_ = 0;
 	void* curl_handle_ = nullptr;
 	curl_slist* curl_list_ = nullptr;
+	std::function<void(int)> done_;
 };
 
 #endif
\ No newline at end of file
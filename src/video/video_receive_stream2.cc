@@ -47,6 +47,7 @@
 #include "rtc_base/trace_event.h"
 #include "system_wrappers/include/clock.h"
 #include "system_wrappers/include/field_trial.h"
+#include "system_wrappers/include/ntp_time.h"
 #include "video/call_stats2.h"
 #include "video/frame_dumping_decoder.h"
 #include "video/receive_statistics_proxy2.h"
@@ -519,8 +520,22 @@ VideoReceiveStream::Stats VideoReceiveStream2::GetStats() const {
   if (config_.rtp.rtx_ssrc) {
     StreamStatistician* rtx_statistician =
         rtp_receive_statistics_->GetStatistician(config_.rtp.rtx_ssrc);
-    if (rtx_statistician)
+    if (rtx_statistician) {
       stats.total_bitrate_bps += rtx_statistician->BitrateReceived();
+      stats.rtx_packets_received =
+          rtx_statistician->GetReceiveStreamDataCounters().transmitted.packets;
+    }
+  }
+  stats.frame_buffer_frames = frame_buffer_->Size();
+  absl::optional<Syncable::Info> sync_info =
+      rtp_video_stream_receiver_.GetSyncInfo();
+  if (sync_info) {
+    stats.last_sender_report_rtp_timestamp =
+        sync_info->capture_time_source_clock;
+    stats.last_sender_report_ntp_ms =
+        NtpTime(sync_info->capture_time_ntp_secs,
+                sync_info->capture_time_ntp_frac)
+            .ToMs();
   }
   return stats;
 }